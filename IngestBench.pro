@@ -0,0 +1,22 @@
+#
+#  End-to-end benchmark: parse -> QCPGraph::setData/addData -> QCustomPlot::replot
+#  Run with the offscreen platform, e.g. "./IngestBench" (it sets QT_QPA_PLATFORM itself)
+#
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets printsupport
+
+TARGET = IngestBench
+TEMPLATE = app
+CONFIG   += console
+CONFIG   -= app_bundle
+
+INCLUDEPATH += .
+
+SOURCES += bench/ingestbench.cpp \
+           qcustomplot.cpp \
+           sampleprotocol.cpp
+
+HEADERS  += qcustomplot.h \
+            sampleprotocol.h
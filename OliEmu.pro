@@ -0,0 +1,11 @@
+#
+#  Potentiostat emulator on a pseudo-terminal (Linux), see emulator/oliemu.cpp
+#
+
+CONFIG   -= qt app_bundle
+CONFIG   += console
+
+TARGET = oliemu
+TEMPLATE = app
+
+SOURCES += emulator/oliemu.cpp
@@ -0,0 +1,22 @@
+#
+#  Headless batch export of recorded runs to PNG/PDF, see report/olireport.cpp
+#  Runs on the offscreen platform (the workers set QT_QPA_PLATFORM themselves)
+#
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets printsupport
+
+TARGET = OliReport
+TEMPLATE = app
+CONFIG   += console
+CONFIG   -= app_bundle
+
+INCLUDEPATH += .
+
+SOURCES += report/olireport.cpp \
+           qcustomplot.cpp \
+           sampleprotocol.cpp
+
+HEADERS  += qcustomplot.h \
+            sampleprotocol.h
@@ -12,10 +12,15 @@ TEMPLATE = app
 
 SOURCES += main.cpp\
            mainwindow.cpp \
-         qcustomplot.cpp
+         qcustomplot.cpp \
+         acquisitionengine.cpp \
+         sampleprotocol.cpp
 
 HEADERS  += mainwindow.h \
-         qcustomplot.h
+         qcustomplot.h \
+         acquisitionengine.h \
+         sampleprotocol.h \
+         samplering.h
 
 FORMS    += mainwindow.ui
 
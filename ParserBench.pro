@@ -0,0 +1,18 @@
+#
+#  Microbenchmark: text sample parsing, old readLine/QString path vs SampleLineParser
+#
+
+QT       += core
+QT       -= gui
+
+TARGET = ParserBench
+TEMPLATE = app
+CONFIG   += console
+CONFIG   -= app_bundle
+
+INCLUDEPATH += .
+
+SOURCES += bench/parserbench.cpp \
+           sampleprotocol.cpp
+
+HEADERS  += sampleprotocol.h
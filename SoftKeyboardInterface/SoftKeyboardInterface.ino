@@ -23,6 +23,11 @@ float PApotVolt;      // Value delivered from QT instructions
 // Changing Resolution
 char resolution;
 
+// Sample Encoding
+//      A:  one Serial.println(volts, 6) per sample (default)
+//      B:  framed raw 16 bit ADC codes, see sampleprotocol.h in OliView
+char encoding = 'A';
+
 // Changing Sampling Speed
 
 float sampleRateFloat;
@@ -57,7 +62,7 @@ float DACaRef = 3.3;
 
 void setup() {
 
-  Serial.begin(9600);
+  Serial.begin(115200);    // USB serial runs at full speed whatever is passed here
 
   pinMode(LED_BUILTIN, OUTPUT);
   pinMode(readPin, INPUT);
@@ -156,6 +161,25 @@ void loop() {
 
   }
 
+  //---------------------------------------------------------------------------------Parsing Sample Encoding
+  // Example Instruction "encoding!B@#$%"
+  //      A:  text, one line per sample
+  //      B:  binary frames
+  //
+  if (inStruct.startsWith("encoding")) {
+    encoding = twoStruct.charAt(0);
+  }
+
+  //---------------------------------------------------------------------------------Parsing Link Test
+  // Example Instruction "linkTest!20000@#$%"
+  //      Streams that many filler bytes as fast as the link takes them; the host times their
+  //      arrival to find out which sampling rates it can keep up with
+  //
+  if (inStruct.startsWith("linkTest")) {
+    linkTest(twoStruct.toInt());
+    inStruct = "";
+  }
+
   if (inStruct.startsWith("changeSampleRate")) {
     sampleRateFloat = twoStruct.toFloat();
 
@@ -232,7 +256,7 @@ void anoStrip() {
 void sample(float sampTime, int waveType, float startVolt, float endVolt, float scanRate) {
   int samples = round(sampTime * sampleRateFloat); // With delay of 0.5 ms, 2000 samples per second
 
-  Serial.println(samples);
+  beginRun(samples);
   while (usec < 20); // wait
   usec = usec - 20;
 
@@ -251,7 +275,7 @@ void sample(float sampTime, int waveType, float startVolt, float endVolt, float
 
       for (int i = 0; i < samples; i++) {
         value = analogRead(readPin);                  // analog read == # out of 2^16
-        Serial.println(value * aRef / 65535.0-aRef/2, 6);    // ratio, value/2^16, is the percent of ADC reference... * aRef (ADC Reference Voltage) == Voltage measured
+        emitSample((unsigned int)value);              // raw ADC code, emitSample() converts to volts in text encoding
         while (usec < samplingDelay/2); // wait
         usec = usec - samplingDelay/2;
       }
@@ -272,7 +296,7 @@ void sample(float sampTime, int waveType, float startVolt, float endVolt, float
 
         value = analogRead(readPin);                  // analog read == # out of 2^16
         //Serial.println(value * aRef / 65535.0, 6);    // ratio, value/2^16, is the percent of ADC reference... * aRef (ADC Reference Voltage) == Voltage measured
-        Serial.println(value * aRef / 65535.0-aRef/2, 6);    // 
+        emitSample((unsigned int)value);              // raw ADC code, emitSample() converts to volts in text encoding
         if (phase >= twopi) phase = 0;
         while (usec < samplingDelay/2); // wait
         usec = usec - samplingDelay/2;
@@ -290,7 +314,8 @@ void sample(float sampTime, int waveType, float startVolt, float endVolt, float
     {
 
       float val3 = aRef/DACaRef*2047.5 + (startVolt)/DACaRef*4095.0;
-      for (int i = 0; i < round(samples/2); i++) {
+      // rising half, then the falling half gets the rest, so odd counts still send exactly "samples"
+      for (int i = 0; i < samples/2; i++) {
 
         analogWrite(A14, (int)val3);
         val3 += 4095.0*scanRate/(1000.0*sampleRateFloat*DACaRef);
@@ -299,11 +324,11 @@ void sample(float sampTime, int waveType, float startVolt, float endVolt, float
         usec = usec - samplingDelay/2;
 
         value = analogRead(readPin);                  // analog read == # out of 2^16
-        Serial.println(value * aRef / 65535.0-aRef/2, 6);    // ratio, value/2^16, is the percent of ADC reference... * aRef (ADC Reference Voltage) == Voltage measured
+        emitSample((unsigned int)value);              // raw ADC code, emitSample() converts to volts in text encoding
         while (usec < samplingDelay/2); // wait
         usec = usec - samplingDelay/2;
       }
-      for (int i = 0; i < round(samples/2); i++) {
+      for (int i = 0; i < samples - samples/2; i++) {
 
         val3 -= 4095.0*scanRate/(1000.0*sampleRateFloat*DACaRef);
         analogWrite(A14, (int)val3);
@@ -312,7 +337,7 @@ void sample(float sampTime, int waveType, float startVolt, float endVolt, float
         usec = usec - samplingDelay/2;
 
         value = analogRead(readPin);                  // analog read == # out of 2^16
-        Serial.println(value * aRef / 65535.0-aRef/2, 6);    // ratio, value/2^16, is the percent of ADC reference... * aRef (ADC Reference Voltage) == Voltage measured
+        emitSample((unsigned int)value);              // raw ADC code, emitSample() converts to volts in text encoding
         while (usec < samplingDelay/2); // wait
         usec = usec - samplingDelay/2;
       }
@@ -320,6 +345,106 @@ void sample(float sampTime, int waveType, float startVolt, float endVolt, float
     break;
     analogWrite(A14, 0);
   }
+  endRun();
+}
+
+//---------------------------------------------------------------------------------Sample Output
+// Text encoding keeps the original println format. Binary encoding packs the raw ADC codes into
+// frames of up to 32 samples:
+//      0xA5 0x5A type seq len payload[len] fletcher16(type..payload) (little endian)
+//      type 'S': payload = uint32 sample count of the run
+//      type 'D': payload = uint16 ADC codes
+//      type 'E': payload = uint32 samples sent, uint32 checksum
+// Both encodings end the run with the count and checksum (checksum = checksum*31 + code over every
+// code sent), the text encoding as a "#end,<count>,<checksum>" line.
+//
+
+byte frameBuf[5 + 64 + 2];
+byte framePayload = 0;
+byte frameSeq = 0;
+uint32_t runCount = 0;
+uint32_t runChecksum = 0;
+
+void sendFrame(byte type, byte len) {
+  frameBuf[0] = 0xA5;
+  frameBuf[1] = 0x5A;
+  frameBuf[2] = type;
+  frameBuf[3] = frameSeq++;
+  frameBuf[4] = len;
+
+  uint32_t sum1 = 0;
+  uint32_t sum2 = 0;
+  for (int i = 2; i < 5 + len; i++) {
+    sum1 += frameBuf[i];
+    sum2 += sum1;
+  }
+  frameBuf[5 + len] = sum1 % 255;
+  frameBuf[6 + len] = sum2 % 255;
+  Serial.write(frameBuf, 7 + len);
+}
+
+void beginRun(int samples) {
+  runCount = 0;
+  runChecksum = 0;
+  if (encoding == 'B') {
+    frameSeq = 0;
+    framePayload = 0;
+    frameBuf[5] = samples & 0xFF;
+    frameBuf[6] = (samples >> 8) & 0xFF;
+    frameBuf[7] = (samples >> 16) & 0xFF;
+    frameBuf[8] = (samples >> 24) & 0xFF;
+    sendFrame('S', 4);
+  }
+  else {
+    Serial.println(samples);
+  }
+}
+
+void emitSample(unsigned int code) {
+  runCount++;
+  runChecksum = runChecksum * 31 + code;
+  if (encoding == 'B') {
+    frameBuf[5 + framePayload++] = code & 0xFF;
+    frameBuf[5 + framePayload++] = (code >> 8) & 0xFF;
+    if (framePayload == 64) {
+      sendFrame('D', framePayload);
+      framePayload = 0;
+    }
+  }
+  else {
+    Serial.println(code * aRef / 65535.0-aRef/2, 6);    // ratio, value/2^16, is the percent of ADC reference... * aRef (ADC Reference Voltage) == Voltage measured
+  }
+}
+
+void linkTest(long bytes) {
+  byte filler[64];
+  memset(filler, 'U', sizeof(filler));    // never a sync byte or a line end
+  while (bytes > 0) {
+    int n = bytes < 64 ? bytes : 64;
+    Serial.write(filler, n);
+    bytes -= n;
+  }
+  Serial.send_now();
+}
+
+void endRun() {
+  if (encoding == 'B') {
+    if (framePayload > 0) {
+      sendFrame('D', framePayload);
+      framePayload = 0;
+    }
+    for (int i = 0; i < 4; i++) {
+      frameBuf[5 + i] = (runCount >> (8 * i)) & 0xFF;
+      frameBuf[9 + i] = (runChecksum >> (8 * i)) & 0xFF;
+    }
+    sendFrame('E', 8);
+  }
+  else {
+    Serial.print("#end,");
+    Serial.print(runCount);
+    Serial.print(',');
+    Serial.println(runChecksum);
+  }
 }
 
 
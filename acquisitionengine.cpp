@@ -0,0 +1,318 @@
+/************************************************************************************************************
+**                                                                                                         **
+**  Serial acquisition engine for OliView.                                                                 **
+**  UC Davis iGEM 2014                                                                                     **
+**                                                                                                         **
+**                                                                                                         **
+*************************************************************************************************************/
+
+
+#include "acquisitionengine.h"
+#include <QSerialPort>
+#include <QTimer>
+
+/*************************************************************************************************************/
+/************************************************ CONSTRUCTOR ************************************************/
+/*************************************************************************************************************/
+
+AcquisitionEngine::AcquisitionEngine(SampleRing<double> *ring, QObject *parent) :
+    QObject(parent),
+    ring(ring),
+    port(0),
+    state(Idle),
+    mode(TextEncoding),
+    expected(0),
+    received(0),
+    surplus(0),
+    checksum(0),
+    reads(0),
+    bytesRead(0),
+    readNs(0),
+    decodeNs(0),
+    linkExpected(0),
+    linkReceived(0)
+{
+    // a child, so it follows the engine into the reader thread
+    linkTimer = new QTimer(this);
+    linkTimer->setSingleShot(true);
+    connect(linkTimer, SIGNAL(timeout()), this, SLOT(linkTestTimeout()));
+
+    runWatchdog = new QTimer(this);
+    runWatchdog->setInterval(500);
+    connect(runWatchdog, SIGNAL(timeout()), this, SLOT(checkRunAlive()));
+}
+
+/*************************************************************************************************************/
+/********************************************** PORT OWNERSHIP ***********************************************/
+/*************************************************************************************************************/
+
+//-------------------------------------------------------------------------------------------------------Open Port
+// Runs in the reader thread, so the port and its notifiers live there too.
+
+void AcquisitionEngine::openPort(const QString &name, int baudRate)
+{
+    closePort();
+
+    port = new QSerialPort(this);
+    port->setPortName(name);
+    if (port->open(QIODevice::ReadWrite))
+    {
+        port->setBaudRate(baudRate);
+        port->setDataBits(QSerialPort::Data8);
+        port->setParity(QSerialPort::NoParity);
+        port->setStopBits(QSerialPort::OneStop);
+        port->setFlowControl(QSerialPort::NoFlowControl);
+        connect(port, SIGNAL(readyRead()), this, SLOT(readAvailable()));
+        emit portOpened(name, true);
+    }
+    else
+    {
+        delete port;
+        port = 0;
+        emit portOpened(name, false);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------Close Port
+
+void AcquisitionEngine::closePort()
+{
+    abortRun();
+    if (port) {
+        port->close();
+        delete port;
+        port = 0;
+    }
+}
+
+//-------------------------------------------------------------------------------------------------Change Link Speed
+
+void AcquisitionEngine::setBaudRate(int baudRate)
+{
+    if (port)
+        port->setBaudRate(baudRate);
+}
+
+//-------------------------------------------------------------------------------------------------Send Instruction
+
+void AcquisitionEngine::write(const QByteArray &command)
+{
+    if (port)
+        port->write(command);
+}
+
+/*************************************************************************************************************/
+/************************************************ RUN STATE **************************************************/
+/*************************************************************************************************************/
+
+//------------------------------------------------------------------------------------------Text Or Binary Framing
+// Only changes how the host decodes; the matching "encoding" instruction is sent by the caller.
+
+void AcquisitionEngine::setEncoding(int encoding)
+{
+    mode = Encoding(encoding);
+    decoder.reset();
+    parser.reset();
+}
+
+//-------------------------------------------------------------------------------------------------Arm For A New Run
+// Must be queued before the instruction is written, so the announced sample count is not missed.
+
+void AcquisitionEngine::startRun()
+{
+    // anything still buffered belongs to an earlier (aborted) run
+    if (port)
+        port->readAll();
+
+    linkTimer->stop();
+    state = AwaitingHeader;
+    expected = 0;
+    received = 0;
+    surplus = 0;
+    checksum = 0;
+    reads = 0;
+    bytesRead = 0;
+    readNs = 0;
+    decodeNs = 0;
+    decoder.reset();
+    parser.reset();
+    ring->resetStatistics();
+
+    lastData.start();
+    runWatchdog->start();
+}
+
+//---------------------------------------------------------------------------------------------------Abort Current Run
+
+void AcquisitionEngine::abortRun()
+{
+    runWatchdog->stop();
+    state = Idle;
+}
+
+//---------------------------------------------------------------------------------------------------Stream Stopped
+// The firmware never pauses within a run, so a silent port means the rest of it is not coming.
+
+void AcquisitionEngine::checkRunAlive()
+{
+    if (state != AwaitingHeader && state != Receiving) {
+        runWatchdog->stop();
+        return;
+    }
+    if (lastData.elapsed() < 2000)
+        return;
+
+    if (state == AwaitingHeader)
+        finishRun(RunNoAnswer);
+    else if (received < expected)
+        finishRun(RunTruncated);
+    else
+        finishRun(RunNoTrailer);
+}
+
+/*************************************************************************************************************/
+/************************************************ LINK TEST **************************************************/
+/*************************************************************************************************************/
+
+//-----------------------------------------------------------------------------------------------Start Measurement
+
+void AcquisitionEngine::measureLink(int bytes)
+{
+    if (!port || bytes <= 0) {
+        emit linkMeasured(0);
+        return;
+    }
+
+    port->readAll();
+    state = LinkTest;
+    linkExpected = bytes;
+    linkReceived = 0;
+
+    port->write("linkTest!" + QByteArray::number(bytes) + "@#$%");
+    linkClock.start();
+    linkTimer->start(3000);
+}
+
+//-------------------------------------------------------------------------------------------------Count Filler Bytes
+
+void AcquisitionEngine::readLinkTest()
+{
+    linkReceived += port->readAll().size();
+
+    if (linkReceived >= linkExpected)
+        finishLinkTest();
+}
+
+void AcquisitionEngine::linkTestTimeout()
+{
+    if (state == LinkTest)
+        finishLinkTest();   // report what did arrive, a slow link is exactly what we want to know about
+}
+
+//-----------------------------------------------------------------------------------------------------Report Rate
+// Timed from the request, so the round trip is included and the result errs on the slow side.
+
+void AcquisitionEngine::finishLinkTest()
+{
+    linkTimer->stop();
+    state = Idle;
+
+    qint64 ns = linkClock.nsecsElapsed();
+    emit linkMeasured((ns > 0 && linkReceived > 0) ? linkReceived / (ns / 1e9) : 0);
+}
+
+/*************************************************************************************************************/
+/************************************** CONSUME BYTES AS THEY ARRIVE *****************************************/
+/*************************************************************************************************************/
+
+void AcquisitionEngine::readAvailable()
+{
+    if (state == Idle) {
+        port->readAll();    // nobody is listening, don't let stale data pile up
+        return;
+    }
+
+    lastData.restart();
+
+    if (state == LinkTest) {
+        readLinkTest();
+        return;
+    }
+
+    // timed separately, so a slow lab PC can be told apart from a slow link (see runProfiled)
+    QElapsedTimer clock;
+    clock.start();
+    QByteArray bytes = port->readAll();
+    readNs += clock.nsecsElapsed();
+    bytesRead += bytes.size();
+    reads++;
+
+    // the line parser works on the raw read buffer; no per-line QByteArray or QString is created
+    clock.restart();
+    if (mode == BinaryEncoding)
+        decoder.feed(bytes.constData(), bytes.size(), this);
+    else
+        parser.feed(bytes.constData(), bytes.size(), this);
+    decodeNs += clock.nsecsElapsed();
+}
+
+//--------------------------------------------------------------------------------------Decoded Stream (SampleSink)
+
+void AcquisitionEngine::announced(int samples)
+{
+    if (state != AwaitingHeader)
+        return;
+
+    expected = samples;
+    state = Receiving;
+    emit runStarted(expected);
+}
+
+void AcquisitionEngine::decoded(const double *values, int count)
+{
+    if (state != Receiving)
+        return;
+
+    for (int i = 0; i < count; i++)
+        checksum = SampleProtocol::runChecksum(checksum, SampleProtocol::voltsToCode(values[i]));
+
+    int wanted = qBound(0, expected - received, count);  // never pass on more than was announced
+    ring->push(values, wanted);                         // whatever does not fit is counted by the ring
+    received += wanted;
+    surplus += count - wanted;
+}
+
+void AcquisitionEngine::ended(int samples, quint32 sentChecksum)
+{
+    if (state != Receiving)
+        return;
+
+    if (surplus > 0 || samples > expected)
+        finishRun(RunOverlong);
+    else if (received < expected || samples < expected)
+        finishRun(RunTruncated);
+    else if (sentChecksum != checksum)
+        finishRun(RunCorrupted);
+    else
+        finishRun(RunComplete);
+}
+
+//-----------------------------------------------------------------------------------------------------------Run Done
+// Emitted after the last push, so the GUI finds every sample of the run in the ring when it gets here.
+
+void AcquisitionEngine::finishRun(RunStatus status)
+{
+    runWatchdog->stop();
+    state = Idle;
+    QVariantMap profile;
+    profile["reads"] = reads;
+    profile["bytes"] = bytesRead;
+    profile["readMs"] = readNs / 1e6;
+    profile["decodeMs"] = decodeNs / 1e6;
+    profile["malformedLines"] = parser.malformedLines();
+    profile["checksumErrors"] = decoder.checksumErrors();
+    profile["sequenceGaps"] = decoder.sequenceGaps();
+    emit runProfiled(profile);
+
+    emit runFinished(received, status, parser.malformedLines(), surplus);
+}
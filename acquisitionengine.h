@@ -0,0 +1,116 @@
+/************************************************************************************************************
+**                                                                                                         **
+**  Serial acquisition engine for OliView.                                                                 **
+**  UC Davis iGEM 2014                                                                                     **
+**                                                                                                         **
+**                                                                                                         **
+*************************************************************************************************************/
+
+
+#ifndef ACQUISITIONENGINE_H
+#define ACQUISITIONENGINE_H
+
+#include <QObject>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QVariantMap>
+#include "sampleprotocol.h"
+#include "samplering.h"
+
+class QSerialPort;
+class QTimer;
+
+/*
+    Consumes the sample stream of the potentiostat as soon as bytes arrive on the serial port
+    (driven by QSerialPort::readyRead), so no event loop is ever blocked waiting for data.
+
+    The engine is meant to be moved to its own QThread. It owns the serial port (created in
+    openPort(), i.e. in the reader thread) and pushes every decoded sample into a SampleRing that
+    the GUI drains once per frame; repaints and resizes of the plot can therefore never stall
+    ingestion. All public slots must be invoked queued from other threads.
+
+    A run is armed with startRun() before the instruction is written to the device. The firmware
+    answers every instruction with the number of samples it is about to send, followed by one
+    reading per line and a trailer repeating the count with a checksum over the samples. The
+    run ends on the trailer; runFinished() says whether the run arrived complete, short, long or
+    corrupted, or whether the stream stopped without a trailer, and how many malformed lines and
+    surplus samples were thrown away on the way.
+
+    With BinaryEncoding the same information arrives as framed raw ADC codes (see sampleprotocol.h).
+
+    measureLink() asks the firmware to stream a block of filler bytes ("linkTest") and reports the
+    rate they actually arrived at, so the GUI can tell which sampling rates the link can sustain.
+*/
+
+class AcquisitionEngine : public QObject, private SampleSink
+{
+    Q_OBJECT
+
+public:
+    enum Encoding { TextEncoding, BinaryEncoding };
+    enum RunStatus { RunComplete, RunTruncated, RunOverlong, RunCorrupted, RunNoTrailer, RunNoAnswer };
+
+    explicit AcquisitionEngine(SampleRing<double> *ring, QObject *parent = 0);
+
+public slots:
+    void openPort(const QString &name, int baudRate);
+    void closePort();
+    void setBaudRate(int baudRate);
+    void measureLink(int bytes);
+    void write(const QByteArray &command);
+
+    void setEncoding(int encoding);
+    void startRun();
+    void abortRun();
+
+signals:
+    void portOpened(const QString &name, bool ok);
+    void runStarted(int samples);
+    void runProfiled(const QVariantMap &profile);     // time spent reading and decoding, just before runFinished
+    void runFinished(int samples, int status, int malformedLines, int surplusSamples);
+    void linkMeasured(double bytesPerSecond);
+
+private slots:
+    void readAvailable();
+    void linkTestTimeout();
+    void checkRunAlive();
+
+private:
+    enum State { Idle, AwaitingHeader, Receiving, LinkTest };
+
+    void readLinkTest();
+    void finishRun(RunStatus status);
+    void finishLinkTest();
+
+    // SampleSink
+    void announced(int samples);
+    void decoded(const double *values, int count);
+    void ended(int samples, quint32 checksum);
+
+    SampleRing<double> *ring;
+    QSerialPort *port;
+    State state;
+    Encoding mode;
+    SampleFrameDecoder decoder;
+    SampleLineParser parser;
+
+    int expected;           // sample count announced by the firmware
+    int received;           // samples consumed so far in this run
+    int surplus;            // samples beyond the announced count, not passed on
+    quint32 checksum;       // SampleProtocol::runChecksum() over everything received
+
+    int reads;              // readyRead calls in this run
+    qint64 bytesRead;
+    qint64 readNs;
+    qint64 decodeNs;
+
+    QTimer *runWatchdog;    // ends a run whose stream stopped before its trailer
+    QElapsedTimer lastData;
+
+    QTimer *linkTimer;      // gives up on a link test the device does not (fully) answer
+    QElapsedTimer linkClock;
+    int linkExpected;       // filler bytes requested from the firmware
+    int linkReceived;
+};
+
+#endif // ACQUISITIONENGINE_H
@@ -0,0 +1,299 @@
+/************************************************************************************************************
+**                                                                                                         **
+**  End-to-end ingest and plot benchmark for OliView.                                                      **
+**  UC Davis iGEM 2014                                                                                     **
+**                                                                                                         **
+**                                                                                                         **
+*************************************************************************************************************/
+
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+#include <qalgorithms.h>
+#include <qmath.h>
+#include "qcustomplot.h"
+#include "sampleprotocol.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+/*
+    Pushes a synthetic run through the same steps as OliView:
+
+        parse      the firmware byte stream fed 4 KB at a time to SampleFrameDecoder / SampleLineParser
+        insert     setData  - the whole run at once, like a finished run used to be plotted
+                   addData  - 100 frames of new samples (appendData), each followed by a replot, like live plotting
+        replot     QCustomPlot::replot(rpImmediate) on a visible 1200x700 widget
+
+    with the graph keeping its data in a QCPDataMap (map) or a QCPDataVector (vector), and reports
+    samples/s per stage and end to end, replot latency percentiles in ms and the peak resident set
+    size. Every case runs in a child process of its own so the peak RSS belongs to it.
+
+    usage: IngestBench [--points N]... [--mode setData|addData] [--storage map|vector] [--encoding binary|text]
+           default: 1e4, 1e5, 1e6 and 1e7 points, both modes, both storages, binary encoding
+*/
+
+namespace
+{
+const int ReadChunk = 4096;     // roughly what one readyRead delivers
+const int LiveFrames = 100;
+const int FinalReplots = 20;
+
+//---------------------------------------------------------------------------------------Synthetic Stream
+// Same format the firmware (and the emulator) sends, including the end-of-run trailer.
+
+QByteArray le32(quint32 v)
+{
+    QByteArray bytes(4, 0);
+    for (int i = 0; i < 4; i++)
+        bytes[i] = char(v >> (8 * i));
+    return bytes;
+}
+
+void appendFrame(QByteArray *stream, quint8 type, quint8 *sequence, const QByteArray &payload)
+{
+    QByteArray frame;
+    frame.append(char(SampleProtocol::SyncByte1)).append(char(SampleProtocol::SyncByte2));
+    frame.append(char(type)).append(char((*sequence)++)).append(char(payload.size())).append(payload);
+    quint16 sum = SampleProtocol::fletcher16(reinterpret_cast<const quint8 *>(frame.constData()) + 2, frame.size() - 2);
+    frame.append(char(sum & 0xFF)).append(char(sum >> 8));
+    *stream += frame;
+}
+
+QByteArray makeStream(int points, bool binary)
+{
+    QVector<quint16> codes(points);
+    quint32 seed = 1;
+    quint32 checksum = 0;
+    for (int i = 0; i < points; i++) {
+        double t = double(i) / points;
+        double d = (t - 0.5) / 0.05;
+        seed = seed * 1103515245 + 12345;
+        double volts = 0.05 * t + 0.4 * qExp(-d * d) + (int((seed >> 16) % 64) - 32) * 3e-5;
+        codes[i] = SampleProtocol::voltsToCode(volts);
+        checksum = SampleProtocol::runChecksum(checksum, codes[i]);
+    }
+
+    QByteArray stream;
+    if (!binary) {
+        stream.reserve(points * 11 + 64);
+        stream += QByteArray::number(points) + "\r\n";
+        for (int i = 0; i < points; i++)
+            stream += QByteArray::number(SampleProtocol::codeToVolts(codes[i]), 'f', 6) + "\r\n";
+        stream += "#end," + QByteArray::number(points) + "," + QByteArray::number(checksum) + "\r\n";
+        return stream;
+    }
+
+    quint8 sequence = 0;
+    stream.reserve(points * 3 + 64);
+    appendFrame(&stream, SampleProtocol::FrameRunStart, &sequence, le32(points));
+    for (int i = 0; i < points; i += SampleProtocol::SamplesPerFrame) {
+        QByteArray payload;
+        for (int j = i; j < qMin(points, i + SampleProtocol::SamplesPerFrame); j++)
+            payload.append(char(codes[j] & 0xFF)).append(char(codes[j] >> 8));
+        appendFrame(&stream, SampleProtocol::FrameSamples, &sequence, payload);
+    }
+    appendFrame(&stream, SampleProtocol::FrameRunEnd, &sequence, le32(points) + le32(checksum));
+    return stream;
+}
+
+class CollectSink : public SampleSink
+{
+public:
+    QVector<double> values;
+    bool complete;
+
+    CollectSink() : complete(false) {}
+    void announced(int samples) { values.reserve(samples); }
+    void decoded(const double *data, int count)
+    {
+        for (int i = 0; i < count; i++)
+            values.append(data[i]);
+    }
+    void ended(int samples, quint32) { complete = (samples == values.size()); }
+};
+
+double percentile(QVector<double> sorted, double p)
+{
+    if (sorted.isEmpty())
+        return 0;
+    qSort(sorted);
+    int index = qBound(0, int(qCeil(p * sorted.size())) - 1, sorted.size() - 1);
+    return sorted.at(index);
+}
+
+long peakRssKb()
+{
+#ifdef Q_OS_UNIX
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;     // kilobytes on Linux
+#else
+    return -1;
+#endif
+}
+
+//-------------------------------------------------------------------------------------------------One Case
+
+int runCase(int points, bool live, bool vectorStorage, bool binary)
+{
+    QByteArray stream = makeStream(points, binary);
+
+    QCustomPlot plot;
+    plot.setInteractions(QCP::iRangeDrag | QCP::iRangeZoom | QCP::iSelectAxes | QCP::iSelectPlottables);
+    plot.xAxis->setLabel("Milliseconds (ms)");
+    plot.yAxis->setLabel("Volts (V)");
+    plot.yAxis->setRange(-1.024, 1.024);
+    plot.resize(1200, 700);
+    plot.show();
+    QCPGraph *graph = plot.addGraph();
+    graph->setDataStorage(vectorStorage ? QCPGraph::dsVector : QCPGraph::dsMap);
+    QApplication::processEvents();
+
+    // parse
+    QElapsedTimer timer;
+    timer.start();
+    CollectSink sink;
+    SampleFrameDecoder decoder;
+    SampleLineParser parser;
+    for (int pos = 0; pos < stream.size(); pos += ReadChunk) {
+        int n = qMin(ReadChunk, stream.size() - pos);
+        if (binary)
+            decoder.feed(stream.constData() + pos, n, &sink);
+        else
+            parser.feed(stream.constData() + pos, n, &sink);
+    }
+    qint64 parseNs = timer.nsecsElapsed();
+    if (!sink.complete) {
+        QTextStream(stderr) << "parse lost samples: " << sink.values.size() << " of " << points << "\n";
+        return 1;
+    }
+
+    const QVector<double> &values = sink.values;
+    double xStep = 1000 / 10000.0;     // 10 kHz
+    plot.xAxis->setRange(0, points * xStep);
+
+    qint64 insertNs = 0;
+    QVector<double> replotMs;
+    if (!live) {
+        timer.restart();
+        QVector<double> keys(points);
+        for (int i = 0; i < points; i++)
+            keys[i] = i * xStep;
+        graph->setData(keys, values);
+        insertNs = timer.nsecsElapsed();
+
+        for (int r = 0; r < FinalReplots; r++) {
+            timer.restart();
+            plot.replot(QCustomPlot::rpImmediate);
+            replotMs.append(timer.nsecsElapsed() / 1e6);
+        }
+    } else {
+        int perFrame = qMax(1, points / LiveFrames);
+        QVector<double> keys;
+        for (int first = 0; first < points; first += perFrame) {
+            int count = qMin(perFrame, points - first);
+            timer.restart();
+            keys.resize(count);
+            for (int i = 0; i < count; i++)
+                keys[i] = (first + i) * xStep;
+            graph->appendData(keys.constData(), values.constData() + first, count);
+            insertNs += timer.nsecsElapsed();
+
+            timer.restart();
+            plot.replot(QCustomPlot::rpImmediate);
+            replotMs.append(timer.nsecsElapsed() / 1e6);
+        }
+    }
+
+    double replotTotalMs = 0;
+    for (int i = 0; i < replotMs.size(); i++)
+        replotTotalMs += replotMs.at(i);
+    // end to end counts the replots a run really costs: every live frame, or one final replot
+    double endToEndNs = parseNs + insertNs + (live ? replotTotalMs : replotMs.first()) * 1e6;
+
+    QTextStream out(stdout);
+    out << qSetFieldWidth(10) << points << qSetFieldWidth(9) << (live ? "addData" : "setData")
+        << qSetFieldWidth(8) << (vectorStorage ? "vector" : "map")
+        << qSetFieldWidth(8) << (binary ? "binary" : "text")
+        << qSetFieldWidth(13) << qRound64(points / (parseNs / 1e9))
+        << qSetFieldWidth(13) << qRound64(points / (insertNs / 1e9))
+        << qSetFieldWidth(13) << qRound64(points / (endToEndNs / 1e9))
+        << qSetFieldWidth(9) << QString::number(percentile(replotMs, 0.50), 'f', 2)
+        << qSetFieldWidth(9) << QString::number(percentile(replotMs, 0.90), 'f', 2)
+        << qSetFieldWidth(9) << QString::number(percentile(replotMs, 0.99), 'f', 2)
+        << qSetFieldWidth(9) << QString::number(percentile(replotMs, 1.00), 'f', 2)
+        << qSetFieldWidth(11) << peakRssKb() << qSetFieldWidth(0) << "\n";
+    return 0;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QStringList args;
+    for (int i = 1; i < argc; i++)
+        args << QString::fromLocal8Bit(argv[i]);
+
+    QList<int> sizes;
+    QStringList modes;
+    QStringList storages;
+    QString encoding = "binary";
+    bool child = false;
+    for (int i = 0; i < args.size(); i++) {
+        bool hasValue = i + 1 < args.size();
+        if (args.at(i) == "--points" && hasValue)
+            sizes << int(args.at(++i).toDouble());
+        else if (args.at(i) == "--mode" && hasValue)
+            modes << args.at(++i);
+        else if (args.at(i) == "--storage" && hasValue)
+            storages << args.at(++i);
+        else if (args.at(i) == "--encoding" && hasValue)
+            encoding = args.at(++i);
+        else if (args.at(i) == "--case")
+            child = true;
+        else {
+            QTextStream(stderr) << "usage: IngestBench [--points N]... [--mode setData|addData] [--storage map|vector] [--encoding binary|text]\n";
+            return 2;
+        }
+    }
+    if (sizes.isEmpty())
+        sizes << 10000 << 100000 << 1000000 << 10000000;
+    if (modes.isEmpty())
+        modes << "setData" << "addData";
+    if (storages.isEmpty())
+        storages << "map" << "vector";
+
+    if (child) {
+        if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        QApplication app(argc, argv);
+        return runCase(sizes.first(), modes.first() == "addData", storages.first() == "vector", encoding == "binary");
+    }
+
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    out << qSetFieldWidth(10) << "points" << qSetFieldWidth(9) << "mode" << qSetFieldWidth(8) << "store" << qSetFieldWidth(8) << "enc"
+        << qSetFieldWidth(13) << "parse/s" << qSetFieldWidth(13) << "insert/s" << qSetFieldWidth(13) << "e2e/s"
+        << qSetFieldWidth(9) << "p50 ms" << qSetFieldWidth(9) << "p90 ms" << qSetFieldWidth(9) << "p99 ms"
+        << qSetFieldWidth(9) << "max ms" << qSetFieldWidth(11) << "peak kB" << qSetFieldWidth(0) << endl;
+
+    int failures = 0;
+    foreach (int points, sizes) {
+        foreach (const QString &mode, modes) {
+            foreach (const QString &storage, storages) {
+                QProcess process;
+                process.setProcessChannelMode(QProcess::ForwardedChannels);
+                process.start(app.applicationFilePath(), QStringList() << "--case" << "--points" << QString::number(points)
+                              << "--mode" << mode << "--storage" << storage << "--encoding" << encoding);
+                if (!process.waitForFinished(-1) || process.exitCode() != 0)
+                    failures++;
+            }
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
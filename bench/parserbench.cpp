@@ -0,0 +1,126 @@
+/************************************************************************************************************
+**                                                                                                         **
+**  Text parser microbenchmark for OliView.                                                                **
+**  UC Davis iGEM 2014                                                                                     **
+**                                                                                                         **
+**                                                                                                         **
+*************************************************************************************************************/
+
+
+#include <QCoreApplication>
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QVector>
+#include <QTextStream>
+#include "sampleprotocol.h"
+
+/*
+    Builds a run exactly as the firmware prints it (count line, then Serial.println(volts, 6) per
+    sample) and parses it with
+
+        readline   the old parseAndPlot loop: QIODevice::readLine() -> QString -> toDouble()
+        parser     SampleLineParser fed 4 KB at a time, like readyRead delivers it
+
+    usage: ParserBench [samples] [repeats]
+*/
+
+namespace
+{
+QByteArray makeRun(int samples)
+{
+    QByteArray run;
+    run.reserve(samples * 11 + 16);
+    run += QByteArray::number(samples) + "\r\n";
+    quint32 seed = 12345;
+    for (int i = 0; i < samples; i++) {
+        seed = seed * 1103515245 + 12345;
+        run += QByteArray::number(SampleProtocol::codeToVolts(quint16(seed >> 16)), 'f', 6) + "\r\n";
+    }
+    return run;
+}
+
+//-----------------------------------------------------------------------------------------------Old Path
+
+double parseReadLine(const QByteArray &run, QVector<double> *out)
+{
+    QBuffer device;
+    device.setData(run);
+    device.open(QIODevice::ReadOnly);
+
+    QString header = device.readLine();
+    out->reserve(header.toInt());
+    while (device.canReadLine()) {
+        QString inByteArray = device.readLine();
+        out->append(inByteArray.toDouble());
+    }
+    return out->isEmpty() ? 0 : out->last();
+}
+
+//-----------------------------------------------------------------------------------------------New Path
+
+class CollectSink : public SampleSink
+{
+public:
+    explicit CollectSink(QVector<double> *out) : out(out) {}
+    void announced(int samples) { out->reserve(samples); }
+    void decoded(const double *values, int count)
+    {
+        for (int i = 0; i < count; i++)
+            out->append(values[i]);
+    }
+    void ended(int, quint32) {}
+private:
+    QVector<double> *out;
+};
+
+double parseLineParser(const QByteArray &run, QVector<double> *out)
+{
+    const int chunk = 4096;
+    CollectSink sink(out);
+    SampleLineParser parser;
+    for (int pos = 0; pos < run.size(); pos += chunk)
+        parser.feed(run.constData() + pos, qMin(chunk, run.size() - pos), &sink);
+    return out->isEmpty() ? 0 : out->last();
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    int samples = args.size() > 1 ? args.at(1).toInt() : 1000000;
+    int repeats = args.size() > 2 ? args.at(2).toInt() : 5;
+
+    QTextStream out(stdout);
+    QByteArray run = makeRun(samples);
+    out << "samples " << samples << ", " << run.size() << " bytes, best of " << repeats << "\n";
+
+    typedef double (*ParseFunction)(const QByteArray &, QVector<double> *);
+    const char *names[] = { "readline", "parser" };
+    ParseFunction functions[] = { parseReadLine, parseLineParser };
+    QVector<double> results[2];
+
+    for (int f = 0; f < 2; f++) {
+        qint64 best = -1;
+        for (int r = 0; r < repeats; r++) {
+            QVector<double> values;
+            QElapsedTimer timer;
+            timer.start();
+            functions[f](run, &values);
+            qint64 ns = timer.nsecsElapsed();
+            if (best < 0 || ns < best)
+                best = ns;
+            results[f] = values;
+        }
+        out << qSetFieldWidth(10) << names[f] << qSetFieldWidth(0)
+            << qSetFieldWidth(12) << qRound64(samples / (best / 1e9)) << qSetFieldWidth(0) << " samples/s"
+            << qSetFieldWidth(10) << best / 1000 << qSetFieldWidth(0) << " us\n";
+    }
+
+    if (results[0] != results[1]) {
+        out << "MISMATCH: the two paths produced different values\n";
+        return 1;
+    }
+    return 0;
+}
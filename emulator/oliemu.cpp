@@ -0,0 +1,483 @@
+/************************************************************************************************************
+**                                                                                                         **
+**  Pseudo-terminal potentiostat emulator for OliView.                                                     **
+**  UC Davis iGEM 2014                                                                                     **
+**                                                                                                         **
+**                                                                                                         **
+*************************************************************************************************************/
+
+
+/*
+    Stands in for a Teensy running SoftKeyboardInterface.ino. It opens a pseudo-terminal, prints the
+    slave path (and optionally symlinks it), and answers the same instructions as the firmware:
+
+        anoStrip!start@peak#scanRate$waveType%
+        cycVolt!start@peak#scanRate$waveType%
+        potAmpero!time@potential#$%
+        resolution!X@#$%
+        encoding!A@#$%  /  encoding!B@#$%
+        changeSampleRate!kHz@#$%
+        linkTest!bytes@#$%
+
+    Runs are sent in the firmware's exact wire format (count line or 'S' frame, samples, "#end"
+    line or 'E' frame), so OliView cannot tell the difference. The run lengths follow the
+    firmware's float math, with one exception: changeSampleRate is taken in kHz, the way the GUI
+    means it ("changeSampleRate!10@" is 10000 samples/s), where the firmware multiplies by the
+    bare number. The samples are a synthetic voltammogram: a sloped baseline, a stripping peak and
+    some noise, all following the applied potential.
+
+    Unlike the hardware it can stream faster than real time, so the host acquisition path can be
+    load tested on any Linux machine:
+
+        oliemu [--link /tmp/ttyOLI] [--rate 10000] [--speed 4] [--seed 1] [--quiet]
+
+        --link PATH   also make PATH a symlink to the slave, so the port name stays the same
+        --rate HZ     sampling rate until the host sends changeSampleRate (default 2000)
+        --speed X     X times real time; 0 streams as fast as the host reads (default 1)
+        --seed N      noise seed (default 1)
+        --quiet       no per-run statistics on stderr
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+
+namespace
+{
+const float aRef = 2.048f;      // ADC reference, as in the firmware
+const float twopi = 3.14159f * 2;
+
+struct Options
+{
+    const char *link;
+    double rate;
+    double speed;
+    unsigned int seed;
+    bool quiet;
+};
+
+volatile sig_atomic_t quitRequested = 0;
+
+void requestQuit(int)
+{
+    quitRequested = 1;
+}
+
+double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*************************************************************************************************************/
+/************************************************ SERIAL LINK ************************************************/
+/*************************************************************************************************************/
+
+class Link
+{
+public:
+    Link() : master(-1), slave(-1), bytesSent(0) {}
+
+    bool open(const char *linkPath)
+    {
+        master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+            perror("oliemu: pseudo-terminal");
+            return false;
+        }
+        name = ptsname(master);
+
+        // keep the slave open ourselves: the line stays up while the host reconnects, and raw
+        // mode stops the line discipline from echoing or translating anything
+        slave = ::open(name.c_str(), O_RDWR | O_NOCTTY);
+        if (slave < 0) {
+            perror("oliemu: slave");
+            return false;
+        }
+        termios tio;
+        tcgetattr(slave, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(slave, TCSANOW, &tio);
+
+        if (linkPath) {
+            unlink(linkPath);
+            if (symlink(name.c_str(), linkPath) != 0) {
+                perror("oliemu: symlink");
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const std::string &slaveName() const { return name; }
+
+    // -1 on error, 0 on timeout
+    int read(char *data, int size, int timeoutMs)
+    {
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(master, &fds);
+        timeval tv = { timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+        int ready = select(master + 1, &fds, 0, 0, &tv);
+        if (ready <= 0)
+            return ready < 0 && errno != EINTR ? -1 : 0;
+        int n = ::read(master, data, size);
+        return n < 0 && (errno == EINTR || errno == EAGAIN || errno == EIO) ? 0 : n;
+    }
+
+    // blocks like a full USB buffer does when the host stops reading
+    void write(const void *data, int size)
+    {
+        const char *p = static_cast<const char *>(data);
+        while (size > 0 && !quitRequested) {
+            int n = ::write(master, p, size);
+            if (n < 0) {
+                if (errno == EINTR || errno == EAGAIN)
+                    continue;
+                perror("oliemu: write");
+                return;
+            }
+            p += n;
+            size -= n;
+            bytesSent += n;
+        }
+    }
+
+    void print(const char *text) { write(text, strlen(text)); }
+
+    long long sent() const { return bytesSent; }
+
+private:
+    int master;
+    int slave;
+    std::string name;
+    long long bytesSent;
+};
+
+/*************************************************************************************************************/
+/************************************************* FIRMWARE **************************************************/
+/*************************************************************************************************************/
+
+class Firmware
+{
+public:
+    Firmware(Link *link, const Options &options) :
+        link(link), options(options), field(0), resolution('A'), encoding('A'),
+        sampleRateHz(float(options.rate)), noiseState(options.seed ? options.seed : 1),
+        framePayload(0), frameSeq(0), runCount(0), runChecksum(0)
+    {
+    }
+
+    //---------------------------------------------------------------------------------------Instruction Input
+    // The firmware reads the five fields with readStringUntil('!' '@' '#' '$' '%').
+
+    void feed(const char *data, int size)
+    {
+        for (int i = 0; i < size; i++) {
+            char c = data[i];
+            static const char separators[] = "!@#$%";
+            if (c == separators[field]) {
+                if (++field == 5) {
+                    execute();
+                    for (int f = 0; f < 5; f++)
+                        fields[f].clear();
+                    field = 0;
+                }
+            } else if (fields[field].size() < 64) {
+                fields[field] += c;
+            }
+        }
+    }
+
+private:
+    static bool startsWith(const std::string &s, const char *prefix)
+    {
+        return s.compare(0, strlen(prefix), prefix) == 0;
+    }
+
+    void execute()
+    {
+        const std::string &in = fields[0];
+        float two = atof(fields[1].c_str());
+        float three = atof(fields[2].c_str());
+        float four = atof(fields[3].c_str());
+        int five = atoi(fields[4].c_str());
+
+        if (startsWith(in, "anoStrip")) {
+            float sampTime = (five == 2 ? 2000 : 1000) * (three - two) / four;
+            sample(sampTime, five, two, three);
+        } else if (startsWith(in, "cycVolt")) {
+            sample(2000 * (three - two) / four, five, two, three);
+        } else if (startsWith(in, "potAmpero")) {
+            sample(two, 0, three, 0);
+        } else if (startsWith(in, "resolution")) {
+            resolution = fields[1].empty() ? 'A' : fields[1][0];
+        } else if (startsWith(in, "encoding")) {
+            encoding = fields[1].empty() ? 'A' : fields[1][0];
+        } else if (startsWith(in, "changeSampleRate")) {
+            sampleRateHz = two * 1000;
+        } else if (startsWith(in, "linkTest")) {
+            linkTest(atol(fields[1].c_str()));
+        } else if (!options.quiet) {
+            fprintf(stderr, "oliemu: ignored instruction \"%s\"\n", in.c_str());
+        }
+    }
+
+    //-----------------------------------------------------------------------------------------Sampling Loop
+
+    void sample(float sampTime, int waveType, float startVolt, float endVolt)
+    {
+        int samples = int(roundf(sampTime * sampleRateHz));
+        if (samples < 0)
+            samples = 0;
+
+        double interval = options.speed > 0 ? 1.0 / (sampleRateHz * options.speed) : 0;
+        double begin = now();
+        long long bytesBefore = link->sent();
+
+        beginRun(samples);
+
+        float volts = startVolt;
+        float phase = 0;
+        float step = (waveType == 2 && samples > 1) ? 2 * (endVolt - startVolt) / samples : 0;
+        for (int i = 0; i < samples && !quitRequested; i++) {
+            switch (waveType) {
+            case 1:
+                volts = sinf(phase) * endVolt;
+                phase += 100000 / sampleRateHz;
+                if (phase >= twopi)
+                    phase = 0;
+                break;
+            case 2:
+                volts += (i < samples / 2) ? step : -step;
+                break;
+            default:
+                break;
+            }
+            emitSample(measure(volts));
+
+            // keep pace in 1 ms worth of samples, sleeping per sample would cost more than it sends
+            if (interval > 0 && (i & 63) == 63) {
+                double due = begin + (i + 1) * interval;
+                double wait = due - now();
+                if (wait > 0.0005) {
+                    timespec ts = { time_t(wait), long((wait - time_t(wait)) * 1e9) };
+                    nanosleep(&ts, 0);
+                }
+            }
+        }
+
+        endRun();
+
+        if (!options.quiet) {
+            double elapsed = now() - begin;
+            fprintf(stderr, "oliemu: %d samples (%c), %lld bytes in %.3f s = %.0f samples/s\n",
+                    samples, encoding, link->sent() - bytesBefore, elapsed,
+                    elapsed > 0 ? samples / elapsed : 0.0);
+        }
+    }
+
+    //--------------------------------------------------------------------------------------Synthetic Signal
+    // Output of the transimpedance stage in volts for the applied potential: a sloped baseline, a
+    // Gaussian stripping peak at 0.35 V and about one code of noise. The resolution setting scales
+    // the current like the feedback resistor switch would.
+
+    unsigned int measure(float volts)
+    {
+        static const float gains[] = { 0.1f, 0.3f, 0.6f, 0.9f };
+        int range = (resolution >= 'A' && resolution <= 'D') ? resolution - 'A' : 0;
+
+        float baseline = 0.05f * volts;
+        float d = (volts - 0.35f) / 0.06f;
+        float peak = 0.4f * expf(-d * d);
+        float signal = gains[range] * (baseline + peak) + noise() * 3.0e-5f;
+
+        long code = lroundf((signal + aRef / 2) * 65535.0f / aRef);
+        return code < 0 ? 0 : (code > 65535 ? 65535 : (unsigned int)code);
+    }
+
+    float noise()
+    {
+        // xorshift32, uniform in [-1, 1)
+        noiseState ^= noiseState << 13;
+        noiseState ^= noiseState >> 17;
+        noiseState ^= noiseState << 5;
+        return (noiseState >> 8) / float(1 << 23) - 1.0f;
+    }
+
+    //-----------------------------------------------------------------------------------------Sample Output
+    // Same wire format as beginRun() / emitSample() / endRun() in the firmware.
+
+    void sendFrame(uint8_t type, uint8_t len)
+    {
+        frameBuf[0] = 0xA5;
+        frameBuf[1] = 0x5A;
+        frameBuf[2] = type;
+        frameBuf[3] = frameSeq++;
+        frameBuf[4] = len;
+
+        uint32_t sum1 = 0;
+        uint32_t sum2 = 0;
+        for (int i = 2; i < 5 + len; i++) {
+            sum1 += frameBuf[i];
+            sum2 += sum1;
+        }
+        frameBuf[5 + len] = sum1 % 255;
+        frameBuf[6 + len] = sum2 % 255;
+        link->write(frameBuf, 7 + len);
+    }
+
+    void beginRun(int samples)
+    {
+        runCount = 0;
+        runChecksum = 0;
+        if (encoding == 'B') {
+            frameSeq = 0;
+            framePayload = 0;
+            for (int i = 0; i < 4; i++)
+                frameBuf[5 + i] = (uint32_t(samples) >> (8 * i)) & 0xFF;
+            sendFrame('S', 4);
+        } else {
+            char line[16];
+            snprintf(line, sizeof(line), "%d\r\n", samples);
+            link->print(line);
+        }
+    }
+
+    void emitSample(unsigned int code)
+    {
+        runCount++;
+        runChecksum = runChecksum * 31 + code;
+        if (encoding == 'B') {
+            frameBuf[5 + framePayload++] = code & 0xFF;
+            frameBuf[5 + framePayload++] = (code >> 8) & 0xFF;
+            if (framePayload == 64) {
+                sendFrame('D', framePayload);
+                framePayload = 0;
+            }
+        } else {
+            char line[24];
+            snprintf(line, sizeof(line), "%.6f\r\n", code * aRef / 65535.0 - aRef / 2);
+            link->print(line);
+        }
+    }
+
+    void endRun()
+    {
+        if (encoding == 'B') {
+            if (framePayload > 0) {
+                sendFrame('D', framePayload);
+                framePayload = 0;
+            }
+            for (int i = 0; i < 4; i++) {
+                frameBuf[5 + i] = (runCount >> (8 * i)) & 0xFF;
+                frameBuf[9 + i] = (runChecksum >> (8 * i)) & 0xFF;
+            }
+            sendFrame('E', 8);
+        } else {
+            char line[40];
+            snprintf(line, sizeof(line), "#end,%u,%u\r\n", unsigned(runCount), unsigned(runChecksum));
+            link->print(line);
+        }
+    }
+
+    void linkTest(long bytes)
+    {
+        char filler[64];
+        memset(filler, 'U', sizeof(filler));
+        while (bytes > 0 && !quitRequested) {
+            int n = bytes < 64 ? int(bytes) : 64;
+            link->write(filler, n);
+            bytes -= n;
+        }
+    }
+
+    Link *link;
+    Options options;
+
+    std::string fields[5];
+    int field;                  // the one being read, '!' '@' '#' '$' '%' end them
+
+    char resolution;
+    char encoding;
+    float sampleRateHz;
+    uint32_t noiseState;
+
+    uint8_t frameBuf[5 + 64 + 2];
+    uint8_t framePayload;
+    uint8_t frameSeq;
+    uint32_t runCount;
+    uint32_t runChecksum;
+};
+
+//--------------------------------------------------------------------------------------------------Arguments
+
+bool parseArguments(int argc, char *argv[], Options *options)
+{
+    options->link = 0;
+    options->rate = 2000;
+    options->speed = 1;
+    options->seed = 1;
+    options->quiet = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--link" && hasValue)
+            options->link = argv[++i];
+        else if (arg == "--rate" && hasValue)
+            options->rate = atof(argv[++i]);
+        else if (arg == "--speed" && hasValue)
+            options->speed = atof(argv[++i]);
+        else if (arg == "--seed" && hasValue)
+            options->seed = strtoul(argv[++i], 0, 10);
+        else if (arg == "--quiet")
+            options->quiet = true;
+        else
+            return false;
+    }
+    return options->rate > 0 && options->speed >= 0;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (!parseArguments(argc, argv, &options)) {
+        fprintf(stderr, "usage: %s [--link PATH] [--rate HZ] [--speed X] [--seed N] [--quiet]\n", argv[0]);
+        return 2;
+    }
+    signal(SIGINT, requestQuit);
+    signal(SIGTERM, requestQuit);
+
+    Link link;
+    if (!link.open(options.link))
+        return 1;
+    printf("%s\n", options.link ? options.link : link.slaveName().c_str());
+    fflush(stdout);
+
+    Firmware firmware(&link, options);
+    char buffer[256];
+    while (!quitRequested) {
+        int n = link.read(buffer, sizeof(buffer), 200);
+        if (n < 0)
+            break;
+        firmware.feed(buffer, n);
+    }
+
+    if (options.link)
+        unlink(options.link);
+    return 0;
+}
@@ -34,16 +34,21 @@
 
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "acquisitionengine.h"
 #include <QMenuBar>
 #include <QDebug>
 #include <QDesktopWidget>
 #include <QScreen>
 #include <QMessageBox>
 #include <QMetaEnum>
-#include <QSerialPort>
 #include <QSerialPortInfo>
-
-QSerialPort serial;
+#include <QActionGroup>
+#include <QLabel>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
 
 /*************************************************************************************************************/
 /************************************************ CONSTRUCTOR ************************************************/
@@ -52,7 +57,18 @@ QSerialPort serial;
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
-    ui(new Ui::MainWindow)
+    ui(new Ui::MainWindow),
+    samples(0),
+    ring(1 << 18),
+    baudRate(115200),
+    linkBytesPerSecond(0),
+    plotted(0),
+    profiledFrames(0),
+    insertNs(0),
+    replotNs(0),
+    replotMaxNs(0),
+    layoutNs(0),
+    paintNs(0)
 {
     setWindowTitle("OliView");
     ui->setupUi(this);
@@ -62,6 +78,58 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->customPlot->yAxis->setRange(0, 3.3);
     ui->customPlot->xAxis->setLabel("Milliseconds (ms)");
     ui->customPlot->yAxis->setLabel("Volts (V)");
+    // live frames only replot the graph layer and skip the layout pass
+    foreach (QString name, QStringList() << "background" << "grid" << "main" << "axes" << "legend")
+        ui->customPlot->layer(name)->setMode(QCPLayer::lmBuffered);
+    // rasterize replots on a worker thread, so dragging and reading the port don't wait for large overlays;
+    // the renderer keeps the buffered layers as images, so live frames still only redraw the graph layer
+    ui->customPlot->setPlottingHint(QCP::phBackgroundRaster);
+    // prepare the line data of overlaid runs on the thread pool
+    ui->customPlot->setPlottingHint(QCP::phParallelPreparation);
+
+    // the serial port is owned and read by the engine in its own thread
+    engine = new AcquisitionEngine(&ring);
+    engine->moveToThread(&acquisitionThread);
+    connect(&acquisitionThread, SIGNAL(finished()), engine, SLOT(deleteLater()));
+    connect(engine, SIGNAL(portOpened(QString,bool)), this, SLOT(portOpened(QString,bool)));
+    connect(engine, SIGNAL(runStarted(int)), this, SLOT(runStarted(int)));
+    connect(engine, SIGNAL(runProfiled(QVariantMap)), this, SLOT(runProfiled(QVariantMap)));
+    connect(engine, SIGNAL(runFinished(int,int,int,int)), this, SLOT(parseAndPlot(int,int,int,int)));
+    connect(engine, SIGNAL(linkMeasured(double)), this, SLOT(linkMeasured(double)));
+    acquisitionThread.start();
+
+    setMaxFrameRate(30);
+    connect(&frameTimer, SIGNAL(timeout()), this, SLOT(drainSamples()));
+
+    portGroup = new QActionGroup(this);
+    connect(portGroup, SIGNAL(triggered(QAction*)), this, SLOT(portSelected(QAction*)));
+    connect(ui->actionReconnect, SIGNAL(triggered()), this, SLOT(reconnectSelected()));
+
+    // USB serial ignores this, a real UART in between does not
+    QMenu *speedMenu = ui->menuSerial_Port->addMenu("Link Speed");
+    baudGroup = new QActionGroup(this);
+    const int baudRates[] = { 9600, 57600, 115200, 230400, 460800, 921600 };
+    for (unsigned int i = 0; i < sizeof(baudRates)/sizeof(baudRates[0]); i++) {
+        QAction *action = speedMenu->addAction(QString("%1 baud").arg(baudRates[i]));
+        action->setCheckable(true);
+        action->setChecked(baudRates[i] == baudRate);
+        action->setData(baudRates[i]);
+        baudGroup->addAction(action);
+    }
+    connect(baudGroup, SIGNAL(triggered(QAction*)), this, SLOT(baudSelected(QAction*)));
+
+    // lower rates leave more time to the rest of the GUI during long runs
+    QMenu *frameRateMenu = ui->menuGraph->addMenu("Live Frame Rate");
+    frameRateGroup = new QActionGroup(this);
+    const int frameRates[] = { 10, 15, 30, 60, 120 };
+    for (unsigned int i = 0; i < sizeof(frameRates)/sizeof(frameRates[0]); i++) {
+        QAction *action = frameRateMenu->addAction(QString("%1 fps").arg(frameRates[i]));
+        action->setCheckable(true);
+        action->setChecked(frameRates[i] == maxFrameRate);
+        action->setData(frameRates[i]);
+        frameRateGroup->addAction(action);
+    }
+    connect(frameRateGroup, SIGNAL(triggered(QAction*)), this, SLOT(frameRateSelected(QAction*)));
 
     fillPortsInfo();
     setUpComPort();
@@ -91,6 +159,25 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->action5000_Hz, SIGNAL(triggered()), this, SLOT(rate5000Selected()));
     connect(ui->action10000_Hz, SIGNAL(triggered()), this, SLOT(rate10000Selected()));
 
+    ui->menuSampling_Rate->addSeparator();
+    binaryAction = ui->menuSampling_Rate->addAction("Binary Streaming");
+    binaryAction->setCheckable(true);
+    binaryAction->setChecked(true);
+    connect(binaryAction, SIGNAL(toggled(bool)), this, SLOT(encodingToggled(bool)));
+    encodingToggled(binaryAction->isChecked());
+
+    ui->menuGraph->addSeparator();
+    QAction *abortAction = ui->menuGraph->addAction("Abort Run");
+    abortAction->setShortcut(QKeySequence(Qt::Key_Escape));
+    connect(abortAction, SIGNAL(triggered()), this, SLOT(abortSelected()));
+
+    profileLabel = new QLabel(this);
+    profileLabel->setVisible(false);
+    ui->statusBar->addPermanentWidget(profileLabel);
+    profileAction = ui->menuGraph->addAction("Show Timings");
+    profileAction->setCheckable(true);
+    connect(profileAction, SIGNAL(toggled(bool)), this, SLOT(profilingToggled(bool)));
+
     sampleRate = 2000;
     waveNum = 0;
 }
@@ -126,11 +213,6 @@ void MainWindow::waveType()
         waveNum = 0;    //stay with default value for graphing
         return;
     }
-    if (index == 2) {
-        samples = 2*samples;
-
-    }
-
     waveNum = index;
 }
 
@@ -141,22 +223,94 @@ void MainWindow::waveType()
 
 void MainWindow::setUpComPort()
 {
-    serial.setPortName("com3");
-    if (serial.open(QIODevice::ReadWrite))
-    {
-        serial.setBaudRate(QSerialPort::Baud9600);
-        serial.setDataBits(QSerialPort::Data8);
-        serial.setParity(QSerialPort::NoParity);
-        serial.setStopBits(QSerialPort::OneStop);
-        serial.setFlowControl(QSerialPort::NoFlowControl);
-        ui->statusBar->showMessage(QString("COM Port Successfully Linked"));
+    linkBytesPerSecond = 0;
+    if (portName.isEmpty()) {
+        ui->statusBar->showMessage(QString("No COM Port found"));
+        return;
     }
+    QMetaObject::invokeMethod(engine, "openPort", Qt::QueuedConnection,
+                              Q_ARG(QString, portName), Q_ARG(int, baudRate));
+}
 
-    else
-    {
-        serial.close();
-        ui->statusBar->showMessage(QString("Unable to Reach COM Port"));
+void MainWindow::portOpened(const QString &name, bool ok)
+{
+    if (ok) {
+        ui->statusBar->showMessage(QString("COM Port Successfully Linked (%1), measuring link speed...").arg(name));
+
+        // a freshly opened or replugged device is back in text mode
+        sendEncoding(binaryAction->isChecked());
+
+        // about one second worth of bytes at the nominal speed
+        int testBytes = qBound(2048, baudRate / 10, 65536);
+        QMetaObject::invokeMethod(engine, "measureLink", Qt::QueuedConnection, Q_ARG(int, testBytes));
+    } else {
+        ui->statusBar->showMessage(QString("Unable to Reach COM Port %1").arg(name));
+    }
+}
+
+//----------------------------------------------------------------------------------------------Link Test Result
+
+void MainWindow::linkMeasured(double bytesPerSecond)
+{
+    linkBytesPerSecond = bytesPerSecond;
+    if (bytesPerSecond <= 0) {
+        ui->statusBar->showMessage(QString("COM Port linked, but the device did not answer the link test"));
+        return;
     }
+
+    int binaryRate = int(bytesPerSecond / SampleProtocol::bytesPerSample(true));
+    int textRate = int(bytesPerSecond / SampleProtocol::bytesPerSample(false));
+    ui->statusBar->showMessage(QString("Link: %1 kB/s, sustains up to %2 samples / s binary, %3 samples / s text")
+                               .arg(bytesPerSecond / 1000, 0, 'f', 1).arg(binaryRate).arg(textRate));
+    checkLinkCapacity();
+}
+
+//-----------------------------------------------------------------------------------------Can The Link Keep Up
+// Warns instead of silently losing samples when the rate needs more than the measured link delivers.
+
+bool MainWindow::checkLinkCapacity()
+{
+    if (linkBytesPerSecond <= 0)
+        return true;    // not measured, nothing to say
+
+    double needed = sampleRate * SampleProtocol::bytesPerSample(binaryAction->isChecked());
+    if (needed <= linkBytesPerSecond)
+        return true;
+
+    QMessageBox::warning(this, "OliView",
+                         QString("%1 samples / s needs about %2 kB/s, but the link only delivers %3 kB/s.\n"
+                                 "Samples will be lost. Choose a lower rate%4.")
+                         .arg(sampleRate).arg(needed / 1000, 0, 'f', 1).arg(linkBytesPerSecond / 1000, 0, 'f', 1)
+                         .arg(binaryAction->isChecked() ? "" : " or enable Binary Streaming"));
+    return false;
+}
+
+//----------------------------------------------------------------------------------------------------Port Selection
+
+void MainWindow::portSelected(QAction *action)
+{
+    portName = action->data().toString();
+    setUpComPort();
+}
+
+void MainWindow::baudSelected(QAction *action)
+{
+    baudRate = action->data().toInt();
+    setUpComPort();     // reopen and measure again, the old measurement no longer applies
+}
+
+void MainWindow::reconnectSelected()
+{
+    fillPortsInfo();
+    setUpComPort();
+}
+
+//----------------------------------------------------------------------------------------------Write To The Device
+// The port belongs to the reader thread, so instructions are queued to it rather than written here.
+
+void MainWindow::sendCommand(const QByteArray &command)
+{
+    QMetaObject::invokeMethod(engine, "write", Qt::QueuedConnection, Q_ARG(QByteArray, command));
 }
 
 /*************************************************************************************************************/
@@ -361,19 +515,11 @@ void MainWindow::sampASPressed()
     
     QString mainInstructions = ("anoStrip!"+ASsv+"@"+ASpv+"#"+ASsr+"$"+wave+"%");
     //qDebug() << mainInstructions;
-    serial.write(mainInstructions.toStdString().c_str());
-    float ASpeak = (ui->ASpeakVolt->value());
-    float ASstart = (ui->ASstartVolt->value());
-    float ASscan = (ui->ASscanRate->value())/1000.0;
-    samples = (sampleRate * (ASpeak - ASstart) / ASscan);
+    sendCommand(mainInstructions.toLatin1());
 
     ui->customPlot->clearGraphs();
     ui->customPlot->replot();
 
-    QTimer::singleShot((samples/sampleRate)*1000, this, SLOT(parseAndPlot()));
-
-
-
     //ui->sampButton->setText(QString("Resample"));
 }
 
@@ -399,17 +545,11 @@ void MainWindow::sampCVPressed()
     //qDebug() << CVsr;
 
     QString mainInstructions = ("cycVolt!"+CVsv+"@"+CVpv+"#"+CVsr+"$"+"2%");
-    serial.write(mainInstructions.toStdString().c_str());
+    sendCommand(mainInstructions.toLatin1());
 
-    float CVpeak = (ui->CVpeakVolt->value());
-    float CVstart = (ui->CVstartVolt->value());
-    float CVscan = (ui->CVscanRate->value())/1000.0;
-    samples = (sampleRate * 2 * (CVpeak - CVstart) / CVscan);
     //ui->customPlot->clearGraphs();
     //ui->customPlot->replot();
 
-    QTimer::singleShot((samples/sampleRate)*1000, this, SLOT(parseAndPlot()));
-
     //ui->sampButton->setText(QString("Resample"));
 }
 
@@ -423,12 +563,7 @@ void MainWindow::sampPAPressed()
     QString PAst = QString::number(ui->PAsampTime->value(),'f',2);
 
     QString mainInstructions = ("potAmpero!"+PAst+"@"+PAst+"#$0%");
-    serial.write(mainInstructions.toStdString().c_str());
-
-    float PAtime = (ui->PAsampTime->value());
-    samples = (sampleRate * PAtime);
-
-    QTimer::singleShot((samples/sampleRate)*1000, this, SLOT(parseAndPlot()));
+    sendCommand(mainInstructions.toLatin1());
 
     //ui->sampButton->setText(QString("Resample"));
 }
@@ -439,78 +574,234 @@ void MainWindow::sampPAPressed()
 /***************************** READ DATA FROM SERIAL PORT AND GRAPH THE VALUES *******************************/
 /*************************************************************************************************************/
 
-void MainWindow::parseAndPlot()
-{
-    //ui->statusBar->showMessage(QString("Sampling..."));
-    //double y;
-    //QString inByteArray;
-
-    //qDebug() << serial.canReadLine();
-    // qDebug() << sampleNumber;
-    //qDebug() << samples;
-
-    /* while (sampleNumber < samples) {
-        if (serial.canReadLine()) {
-            sampleNumber++;
-
-            xVal += (double)(1000.0/float(sampleRate));
-            inByteArray = serial.readLine();
-            y = inByteArray.toDouble();
-            //xValues[sampleNumber] = xVal;
-            //yValues[sampleNumber] = y;
-            //qDebug() << xVal;
-            //qDebug() << y;
-            ui->customPlot->graph(graphMemory)->addData(xVal, y);
-            ui->customPlot->replot();
-        }
-        else {
-            recursion();
-        }
-    }*/
-    //ui->statusBar->showMessage(QString("Sampling Done!"));
-    //ui->label->setText(samples);
+//-----------------------------------------------------------------------------------Firmware Announced Sample Count
+
+// The firmware's count is the only one that matters; the host no longer works out its own.
+
+void MainWindow::runStarted(int announced)
+{
+    samples = announced;
+    // room for the whole run at once; samples drained before this arrived may already have grown runValues
+    runValues.reserve(announced);
+    ui->customPlot->xAxis->setRange(0, 1000.0*announced/sampleRate);
+    // frames only replot the graph layer, which keeps ticks and axes as they are; the new range needs a full pass,
+    // also when the first drain created the graph and replotted before this arrived
+    ui->customPlot->replot(QCustomPlot::rpQueued);
+    ui->statusBar->showMessage(QString("Sampling... (%1 samples)").arg(announced));
+}
 
+//-------------------------------------------------------------------------------------------------Live Frame Rate
+// New samples are appended and replotted once per frame, never once per sample, so the cost of
+// watching a run depends on the frame rate and not on the sampling rate.
 
-    QString inByteArray;
+void MainWindow::setMaxFrameRate(int fps)
+{
+    maxFrameRate = qBound(1, fps, 120);
+    frameTimer.setInterval(1000 / maxFrameRate);
+}
 
-    float x = 0;
-    double y = 0;
+void MainWindow::frameRateSelected(QAction *action)
+{
+    setMaxFrameRate(action->data().toInt());   // a running frame timer picks up the new interval
+}
+
+//------------------------------------------------------------------------------------Drain Ring Once Per Frame
 
-    QVector<double> xValues(samples), yValues(samples);
+void MainWindow::drainSamples()
+{
+    int waiting = ring.size();
+    if (waiting == 0)
+        return;
 
-    for (int i = 0; i<samples; i++) {
-        inByteArray = serial.readLine();
-        y = inByteArray.toDouble();
-        xValues[i] = x;
-        yValues[i] = y;
-        x += 1000/float(sampleRate);
+    int old = runValues.size();
+    runValues.resize(old + waiting);
+    int n = ring.pop(runValues.data() + old, waiting);
+    runValues.resize(old + n);
+
+    // the graph may have been removed by the user in the middle of a run, start a new one then
+    bool newGraph = !runGraph;
+    if (newGraph) {
+        runGraph = ui->customPlot->addGraph();
+        runGraph->setDataStorage(QCPGraph::dsVector);   // runs are long and arrive in time order
+        plotted = 0;
     }
 
-    ui->customPlot->addGraph();
-    ui->customPlot->graph(0)->setData(xValues, yValues);
-    ui->customPlot->replot();
-    ui->statusBar->showMessage(QString("Sampling Done!"), 2);
+    QElapsedTimer clock;
+    clock.start();
+    double xStep = 1000/double(sampleRate);
+    int count = runValues.size() - plotted;
+    frameKeys.resize(count);    // keeps its capacity, only a frame larger than all before allocates
+    for (int i = 0; i < count; i++)
+        frameKeys[i] = (plotted + i)*xStep;
+    runGraph->appendData(frameKeys.constData(), runValues.constData() + plotted, count);   // time only grows
+    plotted = runValues.size();
+    qint64 inserted = clock.nsecsElapsed();
+
+    if (newGraph)
+        ui->customPlot->replot(QCustomPlot::rpQueued);   // the legend got a new item
+    else
+        runGraph->layer()->replot();
+    if (profileAction->isChecked())
+        profileFrame(inserted);
+}
+
+//-------------------------------------------------------------------------------------------------------Run Complete
+
+void MainWindow::parseAndPlot(int received, int status, int malformedLines, int surplusSamples)
+{
+    frameTimer.stop();
+    drainSamples();     // the engine pushed the last samples before announcing the end of the run
+
+    QString result;
+    switch (status) {
+    case AcquisitionEngine::RunComplete:  result = QString("Sampling Done! %1 samples").arg(received); break;
+    case AcquisitionEngine::RunTruncated: result = QString("Run incomplete: %1 of %2 samples").arg(received).arg(samples); break;
+    case AcquisitionEngine::RunOverlong:  result = QString("Device sent more than the announced %1 samples, extra dropped").arg(samples); break;
+    case AcquisitionEngine::RunCorrupted: result = QString("Checksum mismatch, %1 samples may be corrupted").arg(received); break;
+    case AcquisitionEngine::RunNoTrailer: result = QString("%1 samples, but the device never confirmed the end of the run").arg(received); break;
+    case AcquisitionEngine::RunNoAnswer:  result = QString("No answer from the device"); break;
+    }
+
+    if (malformedLines > 0)
+        result += QString(", %1 malformed lines skipped").arg(malformedLines);
+    if (surplusSamples > 0)
+        result += QString(", %1 extra samples dropped").arg(surplusSamples);
+    ui->statusBar->showMessage(result + QString(", %1 dropped, peak buffer use %2 of %3")
+                               .arg(ring.overflowCount()).arg(ring.highWaterMark()).arg(ring.capacity()));
+    if (profileAction->isChecked())
+        writeProfile(received, status);
+}
+
+/*************************************************************************************************************/
+/***************************************** PER-PHASE TIMING **************************************************/
+/*************************************************************************************************************/
+
+//---------------------------------------------------------------------------------------------When Timings Toggled
+// Shows where a run's time goes: serial read and decode (engine), insertion into the graph, layout,
+// layer drawing and the final blit (QCustomPlot). Each run is also appended as one JSON line.
+
+void MainWindow::profilingToggled(bool enabled)
+{
+    ui->customPlot->setReplotTimingEnabled(enabled);
+    profileLabel->setVisible(enabled);
+    profileLabel->setText("Timings: waiting for a run");
+    profileLabel->setToolTip(QString("Logged to %1").arg(QStandardPaths::writableLocation(QStandardPaths::DataLocation)
+                                                         + "/timings.jsonl"));
+}
+
+//-----------------------------------------------------------------------------------------------------One Frame
+// The paint time read here is the one of the previous frame, queued replots are painted later.
+
+void MainWindow::profileFrame(qint64 inserted)
+{
+    QCPReplotTimings timings = ui->customPlot->replotTimings();
+
+    profiledFrames++;
+    insertNs += inserted;
+    replotNs += timings.replot;
+    replotMaxNs = qMax(replotMaxNs, timings.replot);
+    layoutNs += timings.preparation + timings.margins + timings.layout;
+    paintNs += timings.paint;
+
+    qint64 layersNs = 0;
+    for (int i = 0; i < timings.layers.size(); i++) {
+        layerNs[timings.layers.at(i).first] += timings.layers.at(i).second;
+        layersNs += timings.layers.at(i).second;
+    }
+
+    profileLabel->setText(QString("insert %1  layout %2  layers %3  blit %4 ms")
+                          .arg(inserted / 1e6, 0, 'f', 2)
+                          .arg((timings.preparation + timings.margins + timings.layout) / 1e6, 0, 'f', 2)
+                          .arg(layersNs / 1e6, 0, 'f', 2)
+                          .arg(timings.paint / 1e6, 0, 'f', 2));
+}
+
+void MainWindow::runProfiled(const QVariantMap &profile)
+{
+    engineProfile = profile;
+}
+
+//--------------------------------------------------------------------------------------------------End Of Run Log
+
+void MainWindow::writeProfile(int received, int status)
+{
+    QJsonObject run = QJsonObject::fromVariantMap(engineProfile);
+    run["time"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    run["samples"] = received;
+    run["status"] = status;
+    run["sampleRate"] = sampleRate;
+    run["encoding"] = binaryAction->isChecked() ? "binary" : "text";
+    run["frames"] = profiledFrames;
+    run["insertMs"] = insertNs / 1e6;
+    run["replotMs"] = replotNs / 1e6;
+    run["replotMaxMs"] = replotMaxNs / 1e6;
+    run["layoutMs"] = layoutNs / 1e6;
+    run["paintMs"] = paintNs / 1e6;
+    QJsonObject layers;
+    for (QMap<QString, qint64>::const_iterator it = layerNs.constBegin(); it != layerNs.constEnd(); ++it)
+        layers[it.key()] = it.value() / 1e6;
+    run["layersMs"] = layers;
+
+    QString folder = QStandardPaths::writableLocation(QStandardPaths::DataLocation);
+    QDir().mkpath(folder);
+    QFile log(folder + "/timings.jsonl");
+    if (log.open(QIODevice::WriteOnly | QIODevice::Append))
+        log.write(QJsonDocument(run).toJson(QJsonDocument::Compact) + "\n");
+
+    profileLabel->setText(QString("read %1  decode %2  insert %3  replot %4  blit %5 ms (%6 frames)")
+                          .arg(engineProfile.value("readMs").toDouble(), 0, 'f', 1)
+                          .arg(engineProfile.value("decodeMs").toDouble(), 0, 'f', 1)
+                          .arg(insertNs / 1e6, 0, 'f', 1)
+                          .arg(replotNs / 1e6, 0, 'f', 1)
+                          .arg(paintNs / 1e6, 0, 'f', 1)
+                          .arg(profiledFrames));
 }
 
 /*************************************************************************************************************/
 /***************************************** CREATE MENU FUNCTIONS *********************************************/
 /*************************************************************************************************************/
 
+//-----------------------------------------------------------------------------------------------When Abort Selected
+// Stops listening; whatever the device still sends for this run is thrown away by the engine.
+
+void MainWindow::abortSelected()
+{
+    frameTimer.stop();
+    QMetaObject::invokeMethod(engine, "abortRun", Qt::BlockingQueuedConnection);
+    drainSamples();
+    ring.discard();
+    ui->statusBar->showMessage(QString("Run aborted after %1 samples").arg(runValues.size()));
+}
+
 //-------------------------------------------------------------------------------------------------When 2000Hz Selected
 
 void MainWindow::sampleSetup() {
     ui->statusBar->showMessage(QString("Sampling..."));
 
-    ui->customPlot->addGraph();
+    runGraph = 0;       // the next run gets a fresh graph once its first samples arrive
+    plotted = 0;
+
+    engineProfile.clear();
+    profiledFrames = 0;
+    insertNs = replotNs = replotMaxNs = layoutNs = paintNs = 0;
+    layerNs.clear();
     sampleNumber = 0;
 
+    // stop a run the reader thread may still be busy with and drop its leftovers
+    QMetaObject::invokeMethod(engine, "abortRun", Qt::BlockingQueuedConnection);
+    ring.discard();
+
+    runValues.clear();
+    QMetaObject::invokeMethod(engine, "startRun", Qt::QueuedConnection);
+    frameTimer.start();
 }
 
 void MainWindow::rate2000Selected()
 {
     sampleRate = 2000;
-    serial.write("changeSampleRate!2@#$%");
+    sendCommand("changeSampleRate!2@#$%");
     ui->statusBar->showMessage(QString("Sampling Rate: 2000 samples / s"));
+    checkLinkCapacity();
 }
 
 //-------------------------------------------------------------------------------------------------When 5000Hz Selected
@@ -518,8 +809,9 @@ void MainWindow::rate2000Selected()
 void MainWindow::rate5000Selected()
 {
     sampleRate = 5000;
-    serial.write("changeSampleRate!5@#$%");
+    sendCommand("changeSampleRate!5@#$%");
     ui->statusBar->showMessage(QString("Sampling Rate: 5000 samples / s"));
+    checkLinkCapacity();
 }
 
 //------------------------------------------------------------------------------------------------When 10000Hz Selected
@@ -527,17 +819,37 @@ void MainWindow::rate5000Selected()
 void MainWindow::rate10000Selected()
 {
     sampleRate = 10000;
-    serial.write("changeSampleRate!10@#$%");
+    sendCommand("changeSampleRate!10@#$%");
     ui->statusBar->showMessage(QString("Sampling Rate: 10000 samples / s"));
+    checkLinkCapacity();
+}
+
+//-------------------------------------------------------------------------------------When Binary Streaming Toggled
+// Raw 16 bit ADC codes in checksummed frames (~2.2 bytes/sample) instead of println'd volts (~10 bytes/sample).
+
+void MainWindow::encodingToggled(bool binary)
+{
+    sendEncoding(binary);
+    ui->statusBar->showMessage(binary ? QString("Binary streaming enabled") : QString("Text streaming enabled"));
+    checkLinkCapacity();
+}
+
+// The firmware boots in text mode, so this is sent again every time a port is opened.
+void MainWindow::sendEncoding(bool binary)
+{
+    QMetaObject::invokeMethod(engine, "setEncoding", Qt::QueuedConnection,
+                              Q_ARG(int, binary ? AcquisitionEngine::BinaryEncoding : AcquisitionEngine::TextEncoding));
+    sendCommand(binary ? "encoding!B@#$%" : "encoding!A@#$%");
 }
 
 //------------------------------------------------------------------------------------------Functionality of Disconnect
 
 void MainWindow::disconnectSelected()
 {
+    frameTimer.stop();
+    QMetaObject::invokeMethod(engine, "closePort", Qt::QueuedConnection);
     clearAllSelected();
     ui->statusBar->showMessage(QString("COM Port is disconnected"));
-    serial.close();
 }
 
 //-----------------------------------------------------------------------------------------------Functionality of Close
@@ -552,7 +864,7 @@ void MainWindow::closeSelected()
 void MainWindow::resetSelected()
 {
     //ui->customPlot->clearGraphs();
-    ui->customPlot->xAxis->setRange(0, 1000*samples/sampleRate);
+    ui->customPlot->xAxis->setRange(0, samples > 0 ? 1000.0*samples/sampleRate : 1000);
     ui->customPlot->yAxis->setRange(0, 3.3);
     ui->customPlot->xAxis->setLabel("Milliseconds (ms)");
     ui->customPlot->yAxis->setLabel("Volts (V)");
@@ -595,25 +907,44 @@ void MainWindow::clearAllSelected()
 
 void MainWindow::fillPortsInfo()
 {
-    //ui->serialPortInfoListBox->clear();
-    //static const QString blankString = QObject::tr("N/A");
-    //QString description;
-    //QString manufacturer;
+    ui->menuSelect_Port->clear();
+
+    // keep the current port if it is still there, otherwise prefer our device, otherwise the first port
+    QAction *current = 0;
+    QAction *device = 0;
+    QAction *first = 0;
 
     foreach (const QSerialPortInfo &info, QSerialPortInfo::availablePorts()) {
-        QStringList list;
-        //description = info.description();
-        //manufacturer = info.manufacturer();
-        list << info.portName();
-        //<< (!description.isEmpty() ? description : blankString)
-        //<< (!manufacturer.isEmpty() ? manufacturer : blankString)
-        //<< info.systemLocation();
-
-        //ui->serialPortInfoListBox->addItem(list.first(), list);
-        for (int i = 0; i < list.size(); i++)
-        {
-            ui->menuSelect_Port->addAction(list.at(i));
-        }
+        bool isDevice = info.hasVendorIdentifier() && info.hasProductIdentifier()
+                && info.vendorIdentifier() == SampleProtocol::DeviceVendorId
+                && info.productIdentifier() == SampleProtocol::DeviceProductId;
+
+        QString text = info.portName();
+        if (isDevice)
+            text += " (Potentiostat)";
+        else if (!info.description().isEmpty())
+            text += " (" + info.description() + ")";
+
+        QAction *action = ui->menuSelect_Port->addAction(text);
+        action->setCheckable(true);
+        action->setData(info.portName());
+        portGroup->addAction(action);
+
+        if (info.portName() == portName)
+            current = action;
+        if (isDevice && !device)
+            device = action;
+        if (!first)
+            first = action;
+    }
+
+    QAction *chosen = current ? current : (device ? device : first);
+    if (chosen) {
+        chosen->setChecked(true);
+        portName = chosen->data().toString();
+    } else {
+        ui->menuSelect_Port->addAction("No ports found")->setEnabled(false);
+        portName.clear();
     }
 }
 
@@ -621,28 +952,28 @@ void MainWindow::fillPortsInfo()
 
 void MainWindow::res10ASelected()
 {
-    serial.write("resolution!A@#$%");
+    sendCommand("resolution!A@#$%");
 }
 
 //----------------------------------------------------------------------------------------When 1000nA Resolution Chosen
 
 void MainWindow::res1000nASelected()
 {
-    serial.write("resolution!B@#$%");
+    sendCommand("resolution!B@#$%");
 }
 
 //-----------------------------------------------------------------------------------------When 100nA Resolution Chosen
 
 void MainWindow::res100nASelected()
 {
-    serial.write("resolution!C@#$%");
+    sendCommand("resolution!C@#$%");
 }
 
 //------------------------------------------------------------------------------------------When 10nA Resolution Chosen
 
 void MainWindow::res10nASelected()
 {
-    serial.write("resolution!D@#$%");
+    sendCommand("resolution!D@#$%");
 }
 
 /*************************************************************************************************************/
@@ -651,8 +982,10 @@ void MainWindow::res10nASelected()
 
 MainWindow::~MainWindow()
 {
+    QMetaObject::invokeMethod(engine, "closePort", Qt::BlockingQueuedConnection);
+    acquisitionThread.quit();
+    acquisitionThread.wait();
     delete ui;
-    serial.close();
 }
 
 
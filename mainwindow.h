@@ -29,7 +29,14 @@
 
 #include <QMainWindow>
 #include <QTimer>
+#include <QThread>
+#include <QPointer>
 #include "qcustomplot.h" // the header file of QCustomPlot
+#include "samplering.h"
+
+class AcquisitionEngine;
+class QActionGroup;
+class QLabel;
 
 namespace Ui {
 class MainWindow;
@@ -46,11 +53,24 @@ public:
     void setupWaveTypes();
     void setupAldeSensGraph(QCustomPlot *customPlot);
     void setUpComPort();
+    void sendCommand(const QByteArray &command);
+    void setMaxFrameRate(int fps);
+    bool checkLinkCapacity();
 
 private slots:
     void waveType();
     void fillPortsInfo();
-    void parseAndPlot();
+    void portOpened(const QString &name, bool ok);
+    void portSelected(QAction *action);
+    void baudSelected(QAction *action);
+    void frameRateSelected(QAction *action);
+    void reconnectSelected();
+    void linkMeasured(double bytesPerSecond);
+    void runStarted(int announced);
+    void drainSamples();
+    void runProfiled(const QVariantMap &profile);
+    void parseAndPlot(int received, int status, int malformedLines, int surplusSamples);
+    void abortSelected();
     void sampleSetup();
     void mouseWheel();
     void mousePress();
@@ -75,11 +95,17 @@ private slots:
     void rate2000Selected();
     void rate5000Selected();
     void rate10000Selected();
+    void encodingToggled(bool binary);
+    void profilingToggled(bool enabled);
 
 private:
+    void sendEncoding(bool binary);
+    void profileFrame(qint64 inserted);
+    void writeProfile(int received, int status);
+
     Ui::MainWindow *ui;
 
-    int samples;
+    int samples;            // announced by the firmware for the current run
     int sampleRate;
 
     //int graphMemory;        // used in parseAndPlot()
@@ -88,6 +114,34 @@ private:
     
     int waveNum;
 
+    SampleRing<double> ring;        // reader thread -> GUI hand-off
+    QThread acquisitionThread;
+    AcquisitionEngine *engine;      // lives in acquisitionThread
+    QTimer frameTimer;              // drains the ring and replots at most maxFrameRate times a second
+    int maxFrameRate;
+    QAction *binaryAction;
+    QActionGroup *portGroup;        // one checkable action per serial port, data() is the port name
+    QActionGroup *baudGroup;
+    QActionGroup *frameRateGroup;   // Graph > Live Frame Rate, data() is the rate in frames per second
+    QString portName;
+    int baudRate;
+    double linkBytesPerSecond;      // measured by the link test after opening the port, 0 if unknown
+    QVector<double> runValues;      // samples received so far in the current run
+    QPointer<QCPGraph> runGraph;    // graph the current run is drawn into, created on first data
+    int plotted;                    // runValues already handed to runGraph
+    QVector<double> frameKeys;      // keys of the samples handed over in one frame, reused every frame
+
+    // per-phase timing of the current run, see profilingToggled()
+    QAction *profileAction;
+    QLabel *profileLabel;           // status bar overlay
+    QVariantMap engineProfile;      // read/decode times reported by the engine at the end of the run
+    int profiledFrames;
+    qint64 insertNs;
+    qint64 replotNs;
+    qint64 replotMaxNs;
+    qint64 layoutNs;
+    qint64 paintNs;
+    QMap<QString, qint64> layerNs;
 
 };
 
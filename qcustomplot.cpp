@@ -25,6 +25,16 @@
 
 #include "qcustomplot.h"
 
+// vector instructions for QCPAxis::coordsToPixels, used if the compiler targets them:
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define QCP_USE_SSE2
+#  include <emmintrin.h>
+#endif
+#ifdef __AVX__
+#  define QCP_USE_AVX
+#  include <immintrin.h>
+#endif
+
 
 
 
@@ -135,6 +145,73 @@ void QCPPainter::drawLine(const QLineF &line)
     QPainter::drawLine(line.toLine());
 }
 
+/*!
+  Sets the brush of the painter. In the \ref pmNoPixmaps mode, a texture brush made from a
+  QPixmap is set with the texture converted to a QImage.
+  
+  \note this function hides the non-virtual base class implementation.
+*/
+void QCPPainter::setBrush(const QBrush &brush)
+{
+  if (mModes.testFlag(pmNoPixmaps) && brush.style() == Qt::TexturePattern)
+  {
+    QBrush imageBrush(brush);
+    imageBrush.setTextureImage(brush.textureImage());
+    QPainter::setBrush(imageBrush);
+  } else
+    QPainter::setBrush(brush);
+}
+
+/*!
+  Draws the \a source rect of \a pixmap into the \a target rect. In the \ref pmNoPixmaps mode,
+  the pixmap is converted to a QImage and drawn with drawImage.
+  
+  \note this function and its overloads hide the non-virtual base class implementations.
+*/
+void QCPPainter::drawPixmap(const QRectF &target, const QPixmap &pixmap, const QRectF &source)
+{
+  if (mModes.testFlag(pmNoPixmaps))
+    QPainter::drawImage(target, pixmap.toImage(), source);
+  else
+    QPainter::drawPixmap(target, pixmap, source);
+}
+
+/*! \overload
+  
+  Draws all of \a pixmap into the \a target rect.
+*/
+void QCPPainter::drawPixmap(const QRectF &target, const QPixmap &pixmap)
+{
+  if (mModes.testFlag(pmNoPixmaps))
+    QPainter::drawImage(target, pixmap.toImage());
+  else
+    QPainter::drawPixmap(target, pixmap, QRectF());
+}
+
+/*! \overload
+  
+  Draws the \a source rect of \a pixmap with its top left corner at \a point, unscaled.
+*/
+void QCPPainter::drawPixmap(const QPointF &point, const QPixmap &pixmap, const QRectF &source)
+{
+  if (mModes.testFlag(pmNoPixmaps))
+    QPainter::drawImage(point, pixmap.toImage(), source);
+  else
+    QPainter::drawPixmap(point, pixmap, source);
+}
+
+/*! \overload
+  
+  Draws \a pixmap with its top left corner at \a point, unscaled.
+*/
+void QCPPainter::drawPixmap(const QPointF &point, const QPixmap &pixmap)
+{
+  if (mModes.testFlag(pmNoPixmaps))
+    QPainter::drawImage(point, pixmap.toImage());
+  else
+    QPainter::drawPixmap(point, pixmap);
+}
+
 /*!
   Sets whether painting uses antialiasing or not. Use this method instead of using setRenderHint
   with QPainter::Antialiasing directly, as it allows QCPPainter to regain pixel exactness between
@@ -720,6 +797,14 @@ void QCPScatterStyle::drawShape(QCPPainter *painter, double x, double y) const
   
   When a layer is deleted, the objects on it are not deleted with it, but fall on the layer below
   the deleted layer, see QCustomPlot::removeLayer.
+  
+  \section layer-buffering Buffered layers
+  
+  A layer in \ref lmBuffered mode (see \ref setMode) keeps a pixmap with its rendered layerables.
+  \ref QCustomPlot::replot redraws all layers as usual, but \ref replot of a buffered layer only
+  redraws that layer and composites it with the unchanged pixmaps of the other buffered layers.
+  For example, with all layers buffered, new data of a graph on the "main" layer is shown with \c
+  graph->layer()->replot(), without redrawing grid, axes, tick labels or legend.
 */
 
 /* start documentation of inline functions */
@@ -753,7 +838,9 @@ QCPLayer::QCPLayer(QCustomPlot *parentPlot, const QString &layerName) :
   mParentPlot(parentPlot),
   mName(layerName),
   mIndex(-1), // will be set to a proper value by the QCustomPlot layer creation function
-  mVisible(true)
+  mVisible(true),
+  mMode(lmLogical),
+  mBufferDirty(true)
 {
   // Note: no need to make sure layerName is unique, because layer
   // management is done with QCustomPlot functions.
@@ -786,6 +873,52 @@ void QCPLayer::setVisible(bool visible)
   mVisible = visible;
 }
 
+/*!
+  Sets whether the layerables of this layer are drawn into the plot on every replot (\ref
+  lmLogical, the default) or kept in a pixmap of the layer (\ref lmBuffered).
+  
+  A buffered layer costs one pixmap of the size of the plot. In exchange, it can be replotted on its
+  own with \ref replot, and is not redrawn when only other buffered layers are replotted. Exports
+  (\ref QCustomPlot::savePdf, \ref QCustomPlot::toPixmap etc.) always draw every layer anew.
+*/
+void QCPLayer::setMode(LayerMode mode)
+{
+  if (mMode != mode)
+  {
+    mMode = mode;
+    mBuffer = QPixmap();
+    mBufferDirty = true;
+  }
+}
+
+/*!
+  Redraws the layerables of this layer and refreshes the plot with it.
+  
+  If the layer is in \ref lmBuffered mode, only this layer (and other buffered layers whose
+  content moved, e.g. because layerables were moved between layers) is redrawn. All other buffered
+  layers are composited from their pixmaps, \ref lmLogical layers are drawn directly. The layout
+  of the plot is not updated, so this is meant for changes that stay within the layer, like new
+  data of a graph. When axis ranges, tick labels, margins or the widget size changed, use \ref
+  QCustomPlot::replot instead.
+  
+  If the layer is in \ref lmLogical mode, or the buffered layers haven't been drawn yet at the
+  current plot size, this performs a full \ref QCustomPlot::replot.
+  
+  With \ref QCP::phBackgroundRaster, the renderer thread keeps an image of each buffered layer
+  instead of the pixmap, which works the same way (see \ref QCPFrameRenderer).
+  
+  The widget surface is refreshed with QWidget::update(), like with \ref QCustomPlot::rpQueued.
+*/
+void QCPLayer::replot()
+{
+  if (mMode == lmBuffered && (mBuffer.size() == mParentPlot->mPaintBuffer.size() || mParentPlot->mPlottingHints.testFlag(QCP::phBackgroundRaster)))
+  {
+    mBufferDirty = true;
+    mParentPlot->replotBufferedLayers();
+  } else
+    mParentPlot->replot(QCustomPlot::rpQueued);
+}
+
 /*! \internal
   
   Adds the \a layerable to the list of this layer. If \a prepend is set to true, the layerable will
@@ -804,6 +937,7 @@ void QCPLayer::addChild(QCPLayerable *layerable, bool prepend)
       mChildren.prepend(layerable);
     else
       mChildren.append(layerable);
+    mBufferDirty = true;
   } else
     qDebug() << Q_FUNC_INFO << "layerable is already child of this layer" << reinterpret_cast<quintptr>(layerable);
 }
@@ -819,7 +953,9 @@ void QCPLayer::addChild(QCPLayerable *layerable, bool prepend)
 */
 void QCPLayer::removeChild(QCPLayerable *layerable)
 {
-  if (!mChildren.removeOne(layerable))
+  if (mChildren.removeOne(layerable))
+    mBufferDirty = true;
+  else
     qDebug() << Q_FUNC_INFO << "layerable is not child of this layer" << reinterpret_cast<quintptr>(layerable);
 }
 
@@ -1916,6 +2052,8 @@ void QCPLayoutElement::setMargins(const QMargins &margins)
     mMargins = margins;
     mRect = mOuterRect.adjusted(mMargins.left(), mMargins.top(), -mMargins.right(), -mMargins.bottom());
   }
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -1933,6 +2071,8 @@ void QCPLayoutElement::setMinimumMargins(const QMargins &margins)
   {
     mMinimumMargins = margins;
   }
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -1948,6 +2088,8 @@ void QCPLayoutElement::setMinimumMargins(const QMargins &margins)
 void QCPLayoutElement::setAutoMargins(QCP::MarginSides sides)
 {
   mAutoMargins = sides;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -2039,6 +2181,8 @@ void QCPLayoutElement::setMarginGroup(QCP::MarginSides sides, QCPMarginGroup *gr
       }
     }
   }
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -2376,6 +2520,8 @@ void QCPLayout::clear()
 */
 void QCPLayout::sizeConstraintsChanged() const
 {
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
   if (QWidget *w = qobject_cast<QWidget*>(parent()))
     w->updateGeometry();
   else if (QCPLayout *l = qobject_cast<QCPLayout*>(parent()))
@@ -2420,6 +2566,8 @@ void QCPLayout::adoptElement(QCPLayoutElement *el)
     el->setParent(this);
     if (!el->parentPlot())
       el->initializeParentPlot(mParentPlot);
+    if (mParentPlot)
+      mParentPlot->invalidateLayout();
   } else
     qDebug() << Q_FUNC_INFO << "Null element passed";
 }
@@ -2442,6 +2590,8 @@ void QCPLayout::releaseElement(QCPLayoutElement *el)
     el->setParentLayerable(0);
     el->setParent(mParentPlot);
     // Note: Don't initializeParentPlot(0) here, because layout element will stay in same parent plot
+    if (mParentPlot)
+      mParentPlot->invalidateLayout();
   } else
     qDebug() << Q_FUNC_INFO << "Null element passed";
 }
@@ -2737,6 +2887,8 @@ void QCPLayoutGrid::setColumnStretchFactor(int column, double factor)
       qDebug() << Q_FUNC_INFO << "Invalid stretch factor, must be positive:" << factor;
   } else
     qDebug() << Q_FUNC_INFO << "Invalid column:" << column;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -2765,6 +2917,8 @@ void QCPLayoutGrid::setColumnStretchFactors(const QList<double> &factors)
     }
   } else
     qDebug() << Q_FUNC_INFO << "Column count not equal to passed stretch factor count:" << factors;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -2788,6 +2942,8 @@ void QCPLayoutGrid::setRowStretchFactor(int row, double factor)
       qDebug() << Q_FUNC_INFO << "Invalid stretch factor, must be positive:" << factor;
   } else
     qDebug() << Q_FUNC_INFO << "Invalid row:" << row;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -2816,6 +2972,8 @@ void QCPLayoutGrid::setRowStretchFactors(const QList<double> &factors)
     }
   } else
     qDebug() << Q_FUNC_INFO << "Row count not equal to passed stretch factor count:" << factors;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -2826,6 +2984,8 @@ void QCPLayoutGrid::setRowStretchFactors(const QList<double> &factors)
 void QCPLayoutGrid::setColumnSpacing(int pixels)
 {
   mColumnSpacing = pixels;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -2836,6 +2996,8 @@ void QCPLayoutGrid::setColumnSpacing(int pixels)
 void QCPLayoutGrid::setRowSpacing(int pixels)
 {
   mRowSpacing = pixels;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -2869,6 +3031,8 @@ void QCPLayoutGrid::expandTo(int newRowCount, int newColumnCount)
   }
   while (mColumnStretchFactors.size() < newColCount)
     mColumnStretchFactors.append(1);
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -2895,6 +3059,8 @@ void QCPLayoutGrid::insertRow(int newIndex)
   for (int col=0; col<columnCount(); ++col)
     newRow.append((QCPLayoutElement*)0);
   mElements.insert(newIndex, newRow);
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -2919,6 +3085,8 @@ void QCPLayoutGrid::insertColumn(int newIndex)
   mColumnStretchFactors.insert(newIndex, 1);
   for (int row=0; row<rowCount(); ++row)
     mElements[row].insert(newIndex, (QCPLayoutElement*)0);
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /* inherits documentation from base class */
@@ -3072,6 +3240,8 @@ void QCPLayoutGrid::simplify()
         mElements[row].removeAt(col);
     }
   }
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /* inherits documentation from base class */
@@ -3274,6 +3444,8 @@ void QCPLayoutInset::setInsetPlacement(int index, QCPLayoutInset::InsetPlacement
     mInsetPlacement[index] = placement;
   else
     qDebug() << Q_FUNC_INFO << "Invalid element index:" << index;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -3290,6 +3462,8 @@ void QCPLayoutInset::setInsetAlignment(int index, Qt::Alignment alignment)
     mInsetAlignment[index] = alignment;
   else
     qDebug() << Q_FUNC_INFO << "Invalid element index:" << index;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -3309,6 +3483,8 @@ void QCPLayoutInset::setInsetRect(int index, const QRectF &rect)
     mInsetRect[index] = rect;
   else
     qDebug() << Q_FUNC_INFO << "Invalid element index:" << index;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /* inherits documentation from base class */
@@ -4160,7 +4336,8 @@ QCPAxis::QCPAxis(QCPAxisRect *parent, AxisType type) :
   mLowestVisibleTick(0),
   mHighestVisibleTick(-1),
   mCachedMarginValid(false),
-  mCachedMargin(0)
+  mCachedMargin(0),
+  mCachedTicksValid(false)
 {
   mGrid->setVisible(false);
   setAntialiased(false);
@@ -4285,6 +4462,7 @@ void QCPAxis::setScaleType(QCPAxis::ScaleType type)
     if (mScaleType == stLogarithmic)
       setRange(mRange.sanitizedForLogScale());
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
     emit scaleTypeChanged(mScaleType);
   }
 }
@@ -4303,6 +4481,7 @@ void QCPAxis::setScaleLogBase(double base)
     mScaleLogBase = base;
     mScaleLogBaseLogInv = 1.0/qLn(mScaleLogBase); // buffer for faster baseLog() calculation
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   } else
     qDebug() << Q_FUNC_INFO << "Invalid logarithmic scale base (must be greater 1):" << base;
 }
@@ -4330,6 +4509,7 @@ void QCPAxis::setRange(const QCPRange &range)
     mRange = range.sanitizedForLinScale();
   }
   mCachedMarginValid = false;
+  mCachedTicksValid = false;
   emit rangeChanged(mRange);
   emit rangeChanged(mRange, oldRange);
 }
@@ -4403,6 +4583,7 @@ void QCPAxis::setRange(double lower, double upper)
     mRange = mRange.sanitizedForLinScale();
   }
   mCachedMarginValid = false;
+  mCachedTicksValid = false;
   emit rangeChanged(mRange);
   emit rangeChanged(mRange, oldRange);
 }
@@ -4447,6 +4628,7 @@ void QCPAxis::setRangeLower(double lower)
     mRange = mRange.sanitizedForLinScale();
   }
   mCachedMarginValid = false;
+  mCachedTicksValid = false;
   emit rangeChanged(mRange);
   emit rangeChanged(mRange, oldRange);
 }
@@ -4470,6 +4652,7 @@ void QCPAxis::setRangeUpper(double upper)
     mRange = mRange.sanitizedForLinScale();
   }
   mCachedMarginValid = false;
+  mCachedTicksValid = false;
   emit rangeChanged(mRange);
   emit rangeChanged(mRange, oldRange);
 }
@@ -4513,6 +4696,7 @@ void QCPAxis::setAutoTicks(bool on)
   {
     mAutoTicks = on;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   }
 }
 
@@ -4535,6 +4719,7 @@ void QCPAxis::setAutoTickCount(int approximateCount)
     {
       mAutoTickCount = approximateCount;
       mCachedMarginValid = false;
+      mCachedTicksValid = false;
     } else
       qDebug() << Q_FUNC_INFO << "approximateCount must be greater than zero:" << approximateCount;
   }
@@ -4561,6 +4746,7 @@ void QCPAxis::setAutoTickLabels(bool on)
   {
     mAutoTickLabels = on;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   }
 }
 
@@ -4582,6 +4768,7 @@ void QCPAxis::setAutoTickStep(bool on)
   {
     mAutoTickStep = on;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   }
 }
 
@@ -4600,6 +4787,7 @@ void QCPAxis::setAutoSubTicks(bool on)
   {
     mAutoSubTicks = on;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   }
 }
 
@@ -4615,6 +4803,7 @@ void QCPAxis::setTicks(bool show)
   {
     mTicks = show;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   }
 }
 
@@ -4627,6 +4816,7 @@ void QCPAxis::setTickLabels(bool show)
   {
     mTickLabels = show;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   }
 }
 
@@ -4670,6 +4860,7 @@ void QCPAxis::setTickLabelType(LabelType type)
   {
     mTickLabelType = type;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   }
 }
 
@@ -4733,6 +4924,7 @@ void QCPAxis::setDateTimeFormat(const QString &format)
   {
     mDateTimeFormat = format;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   }
 }
 
@@ -4749,6 +4941,7 @@ void QCPAxis::setDateTimeFormat(const QString &format)
 void QCPAxis::setDateTimeSpec(const Qt::TimeSpec &timeSpec)
 {
   mDateTimeSpec = timeSpec;
+  mCachedTicksValid = false;
 }
 
 /*!
@@ -4795,6 +4988,7 @@ void QCPAxis::setNumberFormat(const QString &formatCode)
     return;
   }
   mCachedMarginValid = false;
+  mCachedTicksValid = false;
   
   // interpret first char as number format char:
   QString allowedFormatChars = "eEfgG";
@@ -4859,6 +5053,7 @@ void QCPAxis::setNumberPrecision(int precision)
   {
     mNumberPrecision = precision;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   }
 }
 
@@ -4873,6 +5068,7 @@ void QCPAxis::setTickStep(double step)
   {
     mTickStep = step;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   }
 }
 
@@ -4894,6 +5090,7 @@ void QCPAxis::setTickVector(const QVector<double> &vec)
   // don't check whether mTickVector != vec here, because it takes longer than we would save
   mTickVector = vec;
   mCachedMarginValid = false;
+  mCachedTicksValid = false;
 }
 
 /*!
@@ -4912,6 +5109,7 @@ void QCPAxis::setTickVectorLabels(const QVector<QString> &vec)
   // don't check whether mTickVectorLabels != vec here, because it takes longer than we would save
   mTickVectorLabels = vec;
   mCachedMarginValid = false;
+  mCachedTicksValid = false;
 }
 
 /*!
@@ -4972,6 +5170,7 @@ void QCPAxis::setTickLengthOut(int outside)
 void QCPAxis::setSubTickCount(int count)
 {
   mSubTickCount = count;
+  mCachedTicksValid = false;
 }
 
 /*!
@@ -5259,6 +5458,7 @@ void QCPAxis::moveRange(double diff)
     mRange.upper *= diff;
   }
   mCachedMarginValid = false;
+  mCachedTicksValid = false;
   emit rangeChanged(mRange);
   emit rangeChanged(mRange, oldRange);
 }
@@ -5292,6 +5492,7 @@ void QCPAxis::scaleRange(double factor, double center)
       qDebug() << Q_FUNC_INFO << "Center of scaling operation doesn't lie in same logarithmic sign domain as range:" << center;
   }
   mCachedMarginValid = false;
+  mCachedTicksValid = false;
   emit rangeChanged(mRange);
   emit rangeChanged(mRange, oldRange);
 }
@@ -5469,6 +5670,84 @@ double QCPAxis::coordToPixel(double value) const
   }
 }
 
+/*!
+  Transforms \a count values in coordinates of the axis to pixel coordinates of the QCustomPlot
+  widget, like \ref coordToPixel does for a single value.
+  
+  The values are read from \a values, advancing by \a valueStride doubles, and the pixel
+  coordinates are written to \a pixels, advancing by \a pixelStride. This allows transforming
+  e.g. only the keys of a QVector<QCPData> (stride 6) into the x coordinates of a QVector<QPointF>
+  (stride 2), without intermediate copies.
+  
+  The checks for orientation, scale type and range reversal are made once per call, each value
+  then only costs a subtraction, a multiplication and an addition (a logarithm with \ref
+  stLogarithmic). On linear axes, several values are transformed at once with SSE2 or AVX
+  instructions, if the compiler targets them.
+*/
+void QCPAxis::coordsToPixels(const double *values, int valueStride, qreal *pixels, int pixelStride, int count) const
+{
+  if (count <= 0)
+    return;
+  const bool horizontal = orientation() == Qt::Horizontal;
+  const double origin = horizontal ? mAxisRect->left() : mAxisRect->bottom();
+  const double anchor = mRangeReversed ? mRange.upper : mRange.lower;
+  const double direction = (horizontal ? 1 : -1)*(mRangeReversed ? -1 : 1);
+  const double length = horizontal ? mAxisRect->width() : mAxisRect->height();
+  
+  if (mScaleType == stLinear)
+  {
+    // pixel = origin + factor*(value-anchor) is the same calculation as coordToPixel:
+    const double factor = direction*length/mRange.size();
+    int i = 0;
+#ifdef QCP_USE_SSE2
+    if (sizeof(qreal) == sizeof(double))
+    {
+      double *out = reinterpret_cast<double*>(pixels);
+      if (valueStride == 1 && pixelStride == 1)
+      {
+#  ifdef QCP_USE_AVX
+        const __m256d anchor4 = _mm256_set1_pd(anchor), factor4 = _mm256_set1_pd(factor), origin4 = _mm256_set1_pd(origin);
+        for (; i+3<count; i+=4)
+          _mm256_storeu_pd(out+i, _mm256_add_pd(origin4, _mm256_mul_pd(factor4, _mm256_sub_pd(_mm256_loadu_pd(values+i), anchor4))));
+#  endif
+        const __m128d anchor2 = _mm_set1_pd(anchor), factor2 = _mm_set1_pd(factor), origin2 = _mm_set1_pd(origin);
+        for (; i+1<count; i+=2)
+          _mm_storeu_pd(out+i, _mm_add_pd(origin2, _mm_mul_pd(factor2, _mm_sub_pd(_mm_loadu_pd(values+i), anchor2))));
+      } else
+      {
+        const __m128d anchor2 = _mm_set1_pd(anchor), factor2 = _mm_set1_pd(factor), origin2 = _mm_set1_pd(origin);
+        for (; i+1<count; i+=2)
+        {
+          __m128d pixel = _mm_add_pd(origin2, _mm_mul_pd(factor2, _mm_sub_pd(_mm_set_pd(values[(i+1)*valueStride], values[i*valueStride]), anchor2)));
+          _mm_storel_pd(out+i*pixelStride, pixel);
+          _mm_storeh_pd(out+(i+1)*pixelStride, pixel);
+        }
+      }
+    }
+#endif
+    for (; i<count; ++i)
+      pixels[i*pixelStride] = origin+factor*(values[i*valueStride]-anchor);
+  } else // mScaleType == stLogarithmic
+  {
+    // pixel = origin + factor*log(value/anchor), invalid values are placed outside like in coordToPixel:
+    const double factor = direction*length/qLn(mRange.upper/mRange.lower);
+    const double beforeLower = horizontal ? mAxisRect->left()-200 : mAxisRect->bottom()+200;
+    const double beyondUpper = horizontal ? mAxisRect->right()+200 : mAxisRect->top()-200;
+    const double positiveInvalid = mRangeReversed ? beforeLower : beyondUpper; // value >= 0 on a negative range
+    const double negativeInvalid = mRangeReversed ? beyondUpper : beforeLower; // value <= 0 on a positive range
+    for (int i=0; i<count; ++i)
+    {
+      const double value = values[i*valueStride];
+      if (value >= 0 && mRange.upper < 0)
+        pixels[i*pixelStride] = positiveInvalid;
+      else if (value <= 0 && mRange.upper > 0)
+        pixels[i*pixelStride] = negativeInvalid;
+      else
+        pixels[i*pixelStride] = origin+factor*qLn(value/anchor);
+    }
+  }
+}
+
 /*!
   Returns the part of the axis that is hit by \a pos (in pixels). The return value of this function
   is independent of the user-selectable parts defined with \ref setSelectableParts. Further, this
@@ -5609,11 +5888,24 @@ QCPAxis::AxisType QCPAxis::opposite(QCPAxis::AxisType type)
   \ref setAutoTicks is set to true, appropriate tick values are determined automatically via \ref
   generateAutoTicks. If it's set to false, the signal ticksRequest is emitted, which can be used to
   provide external tick positions. Then the sub tick vectors and tick label vectors are created.
+  
+  With automatic ticks and tick labels, the result only depends on the axis range and the tick
+  settings, whose setters clear \a mCachedTicksValid, and on the locale of the plot. If none of
+  them changed since the last call, the vectors are kept as they are. So replots that don't touch
+  the axis, e.g. during live data streaming, don't generate ticks or format labels.
 */
 void QCPAxis::setupTickVectors()
 {
   if (!mParentPlot) return;
-  if ((!mTicks && !mTickLabels && !mGrid->visible()) || mRange.size() <= 0) return;
+  if ((!mTicks && !mTickLabels && !mGrid->visible()) || mRange.size() <= 0)
+  {
+    mCachedTicksValid = false;
+    return;
+  }
+  if (mCachedTicksValid && mAutoTicks && mAutoTickLabels && mCachedTicksLocale == mParentPlot->locale())
+    return;
+  mCachedTicksValid = true;
+  mCachedTicksLocale = mParentPlot->locale();
   
   // fill tick vectors, either by auto generating or by notifying user to fill the vectors himself
   if (mAutoTicks)
@@ -6925,6 +7217,8 @@ QCPAbstractPlottable::QCPAbstractPlottable(QCPAxis *keyAxis, QCPAxis *valueAxis)
 void QCPAbstractPlottable::setName(const QString &name)
 {
   mName = name;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -8764,6 +9058,247 @@ QCP::Interaction QCPAbstractItem::selectionCategory() const
   
 */
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPReplotTimings
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPReplotTimings
+  \brief Durations of the phases of a replot, in nanoseconds
+  
+  Filled by QCustomPlot while \ref QCustomPlot::setReplotTimingEnabled is on and returned by \ref
+  QCustomPlot::replotTimings. \a preparation, \a margins and \a layout are the three layout update
+  phases, \a layers holds the drawing time of every layer by name. \a plotData is the time spent
+  computing the line data of the graphs ahead of the layers with \ref QCP::phParallelPreparation
+  (without it, that work is part of the layer times). \a replot covers the whole replot into the
+  paint buffer, \a paint the copy of that buffer onto the widget surface in the
+  most recent paint event.
+  
+  While nothing affecting the layout changed (see \ref QCustomPlot::invalidateLayout), \a margins
+  only covers the check of the axis margins and \a layout is zero. After a \ref QCPLayer::replot,
+  all layout phases are zero and clean buffered layers only account for copying their pixmap.
+  
+  With \ref QCP::phBackgroundRaster, \a replot and the layer times only cover recording the plot,
+  the rasterization happens on the renderer thread and isn't timed.
+*/
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPGraphPreparation
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPGraphPreparation
+  \brief Prepares the plot data of graphs on a thread of the global QThreadPool
+  
+  This is an internal class used by QCustomPlot when the plotting hint \ref
+  QCP::phParallelPreparation is set. Several instances share one list of graphs and take the next
+  unprepared graph from it via \a nextIndex until the list is exhausted, so a slow graph doesn't
+  hold up the others. Each instance releases \a finished once when it's done.
+*/
+
+QCPGraphPreparation::QCPGraphPreparation(const QList<QCPGraph*> *graphs, QAtomicInt *nextIndex, QSemaphore *finished) :
+  mGraphs(graphs),
+  mNextIndex(nextIndex),
+  mFinished(finished)
+{
+}
+
+void QCPGraphPreparation::run()
+{
+  int index;
+  while ((index = mNextIndex->fetchAndAddOrdered(1)) < mGraphs->size())
+    mGraphs->at(index)->preparePlotData();
+  if (mFinished)
+    mFinished->release();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPFrameRenderer
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPFrameRenderer
+  \brief Rasterizes recorded replots into images on a thread of its own
+  
+  This is an internal class used by QCustomPlot when the plotting hint \ref
+  QCP::phBackgroundRaster is set. The GUI thread records a replot into QPictures, which hold their
+  own copy of everything that is painted (geometry, pens, texts), and hands them over with \ref
+  submit. The renderer thread plays the pictures into a QImage and emits \ref frameReady, the GUI
+  thread then fetches the image with \ref takeFrame and blits it in the paint event. No plot
+  object is ever touched by the renderer thread, so the plot may be changed and replotted while a
+  frame is being rasterized.
+  
+  The renderer thread must not use QPixmaps either, which most platforms only allow on the GUI
+  thread. The pictures are therefore recorded with the painter mode \ref QCPPainter::pmNoPixmaps,
+  which turns pixmaps (backgrounds, pixmap items and scatters, legend icons) and pixmap brushes
+  into QImages while recording. Custom layerables that bypass QCPPainter, e.g. by drawing a pixmap
+  through a QPainter pointer, must do the same when that mode is set.
+  
+  A frame is submitted as a list of \ref Part "parts". Buffered layers (\ref QCPLayer::lmBuffered)
+  get a part with a slot each, the renderer keeps their rasterized images from frame to frame, so
+  a layer is only recorded and rasterized again when it changed. Everything else is recorded into
+  parts without a slot and played into every frame directly.
+  
+  Only the most recently submitted frame is kept. If a new one arrives before the renderer got to
+  the previous one, the previous one is dropped (see \ref droppedFrames), so a slow frame never
+  builds up a backlog behind it. Layer pictures of the dropped frame that the new one relies on
+  are taken over.
+*/
+
+/*! \fn void QCPFrameRenderer::frameReady()
+  
+  This signal is emitted from the renderer thread whenever a frame was finished. Connect to it with
+  a queued connection and fetch the frame with \ref takeFrame.
+*/
+
+/*!
+  Creates a renderer. The thread must be started with QThread::start before frames are rendered.
+*/
+QCPFrameRenderer::QCPFrameRenderer(QObject *parent) :
+  QThread(parent),
+  mHasPending(false),
+  mStopping(false),
+  mHasFrame(false),
+  mDroppedFrames(0)
+{
+}
+
+QCPFrameRenderer::~QCPFrameRenderer()
+{
+  stop();
+}
+
+/*!
+  Returns how many submitted frames were replaced by a newer one before they were rasterized.
+*/
+int QCPFrameRenderer::droppedFrames() const
+{
+  QMutexLocker locker(&mMutex);
+  return mDroppedFrames;
+}
+
+/*!
+  Queues the frame made of \a parts to be rasterized into an image of \a size pixels, which is
+  filled with \a fill first. The parts are drawn in order. Replaces a frame that was submitted
+  before and is still waiting.
+  
+  All layer images are expected to be of \a size. A part whose slot holds no image of that size
+  yet has to come with a picture, otherwise it is left out.
+*/
+void QCPFrameRenderer::submit(const QList<Part> &parts, const QSize &size, const QColor &fill)
+{
+  QMutexLocker locker(&mMutex);
+  QList<Part> newParts = parts;
+  if (mHasPending)
+  {
+    ++mDroppedFrames;
+    // the dropped frame may have been the one to bring a layer image up to date:
+    for (int i=0; i<newParts.size(); ++i)
+    {
+      if (newParts.at(i).slot < 0 || newParts.at(i).hasPicture)
+        continue;
+      for (int k=0; k<mPendingParts.size(); ++k)
+      {
+        if (mPendingParts.at(k).slot == newParts.at(i).slot && mPendingParts.at(k).hasPicture)
+        {
+          newParts[i] = mPendingParts.at(k);
+          break;
+        }
+      }
+    }
+  }
+  mPendingParts = newParts;
+  mPendingSize = size;
+  mPendingFill = fill;
+  mHasPending = true;
+  mWakeUp.wakeOne();
+}
+
+/*!
+  Moves the newest finished frame to \a frame and returns true. Returns false and leaves \a frame
+  untouched if no frame was finished since the last call.
+*/
+bool QCPFrameRenderer::takeFrame(QImage *frame)
+{
+  QMutexLocker locker(&mMutex);
+  if (!mHasFrame)
+    return false;
+  *frame = mFrame;
+  mFrame = QImage();
+  mHasFrame = false;
+  return true;
+}
+
+/*!
+  Makes the renderer thread finish the frame it's working on and quit, and waits for it.
+*/
+void QCPFrameRenderer::stop()
+{
+  {
+    QMutexLocker locker(&mMutex);
+    mStopping = true;
+    mWakeUp.wakeOne();
+  }
+  wait();
+}
+
+/* inherits documentation from base class */
+void QCPFrameRenderer::run()
+{
+  forever
+  {
+    QList<Part> parts;
+    QSize size;
+    QColor fill;
+    {
+      QMutexLocker locker(&mMutex);
+      while (!mHasPending && !mStopping)
+        mWakeUp.wait(&mMutex);
+      if (mStopping)
+        return;
+      parts = mPendingParts;
+      size = mPendingSize;
+      fill = mPendingFill;
+      mPendingParts.clear();
+      mHasPending = false;
+    }
+    
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    if (!image.isNull()) // widget has width or height zero
+    {
+      image.fill(fill);
+      QPainter painter(&image);
+      foreach (const Part &part, parts)
+      {
+        if (part.slot < 0)
+        {
+          painter.drawPicture(0, 0, part.picture);
+          continue;
+        }
+        if (part.slot >= mLayerImages.size())
+          mLayerImages.resize(part.slot+1);
+        QImage &layerImage = mLayerImages[part.slot];
+        if (part.hasPicture)
+        {
+          if (layerImage.size() != size)
+            layerImage = QImage(size, QImage::Format_ARGB32_Premultiplied);
+          layerImage.fill(Qt::transparent);
+          QPainter layerPainter(&layerImage);
+          layerPainter.drawPicture(0, 0, part.picture);
+        }
+        if (layerImage.size() == size)
+          painter.drawImage(0, 0, layerImage);
+      }
+    }
+    
+    {
+      QMutexLocker locker(&mMutex);
+      mFrame = image;
+      mHasFrame = true;
+    }
+    emit frameReady();
+  }
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////// QCustomPlot
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -9089,9 +9624,13 @@ QCustomPlot::QCustomPlot(QWidget *parent) :
   mCurrentLayer(0),
   mPlottingHints(QCP::phCacheLabels|QCP::phForceRepaint),
   mMultiSelectModifier(Qt::ControlModifier),
+  mReplotTimingEnabled(false),
   mPaintBuffer(size()),
   mMouseEventElement(0),
-  mReplotting(false)
+  mReplotting(false),
+  mFrameRenderer(0),
+  mLayoutValid(false),
+  mUpdatingLayout(false)
 {
   setAttribute(Qt::WA_NoMousePropagation);
   setAttribute(Qt::WA_OpaquePaintEvent);
@@ -9143,6 +9682,8 @@ QCustomPlot::QCustomPlot(QWidget *parent) :
 
 QCustomPlot::~QCustomPlot()
 {
+  if (mFrameRenderer)
+    mFrameRenderer->stop();
   clearPlottables();
   clearItems();
 
@@ -9372,7 +9913,16 @@ void QCustomPlot::setNoAntialiasingOnDrag(bool enabled)
 */
 void QCustomPlot::setPlottingHints(const QCP::PlottingHints &hints)
 {
+  if (hints.testFlag(QCP::phBackgroundRaster) != mPlottingHints.testFlag(QCP::phBackgroundRaster))
+  {
+    // layer pixmaps and the layer images of the renderer thread aren't kept up to date in the other mode:
+    foreach (QCPLayer *layer, mLayers)
+      layer->mBufferDirty = true;
+    mRasterLayers.clear();
+  }
   mPlottingHints = hints;
+  if (!mPlottingHints.testFlag(QCP::phBackgroundRaster))
+    mRenderedFrame = QImage(); // paint buffer is used again from the next replot on
 }
 
 /*!
@@ -9407,6 +9957,22 @@ void QCustomPlot::setMultiSelectModifier(Qt::KeyboardModifier modifier)
   mMultiSelectModifier = modifier;
 }
 
+/*!
+  Sets whether the durations of the individual replot phases are measured. If \a enabled, every
+  \ref replot records how long the layout phases, the background and each layer took to draw, and
+  every paint event records how long it took to draw the paint buffer onto the widget. The values
+  of the most recent replot and paint event are available via \ref replotTimings.
+  
+  This is meant to find out which part of a replot is slow on a given machine. It is disabled by
+  default.
+*/
+void QCustomPlot::setReplotTimingEnabled(bool enabled)
+{
+  mReplotTimingEnabled = enabled;
+  if (!enabled)
+    mReplotTimings = QCPReplotTimings();
+}
+
 /*!
   Sets the viewport of this QCustomPlot. The Viewport is the area that the top level layout
   (QCustomPlot::plotLayout()) uses as its rect. Normally, the viewport is the entire widget rect.
@@ -9416,6 +9982,8 @@ void QCustomPlot::setMultiSelectModifier(Qt::KeyboardModifier modifier)
 */
 void QCustomPlot::setViewport(const QRect &rect)
 {
+  if (mViewport != rect)
+    invalidateLayout();
   mViewport = rect;
   if (mPlotLayout)
     mPlotLayout->setOuterRect(mViewport);
@@ -10413,6 +10981,10 @@ void QCustomPlot::deselectAll()
   afterReplot is emitted. It is safe to mutually connect the replot slot with any of those two
   signals on two QCustomPlots to make them replot synchronously, it won't cause an infinite
   recursion.
+  
+  With the plotting hint \ref QCP::phBackgroundRaster, the plot is only recorded here and
+  rasterized on a worker thread. The widget is refreshed once that frame is finished, regardless
+  of \a refreshPriority.
 */
 void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority)
 {
@@ -10421,27 +10993,65 @@ void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority)
   mReplotting = true;
   emit beforeReplot();
   
-  mPaintBuffer.fill(mBackgroundBrush.style() == Qt::SolidPattern ? mBackgroundBrush.color() : Qt::transparent);
-  QCPPainter painter;
-  painter.begin(&mPaintBuffer);
-  if (painter.isActive())
+  QElapsedTimer timer;
+  if (mReplotTimingEnabled)
+    timer.start();
+  
+  // a full replot redraws every layer, buffered ones included:
+  foreach (QCPLayer *layer, mLayers)
+    layer->mBufferDirty = true;
+  
+  if (mPlottingHints.testFlag(QCP::phBackgroundRaster))
   {
-    painter.setRenderHint(QPainter::HighQualityAntialiasing); // to make Antialiasing look good if using the OpenGL graphicssystem
-    if (mBackgroundBrush.style() != Qt::SolidPattern && mBackgroundBrush.style() != Qt::NoBrush)
-      painter.fillRect(mViewport, mBackgroundBrush);
-    draw(&painter);
-    painter.end();
-    if ((refreshPriority == rpHint && mPlottingHints.testFlag(QCP::phForceRepaint)) || refreshPriority==rpImmediate)
-      repaint();
-    else
-      update();
-  } else // might happen if QCustomPlot has width or height zero
-    qDebug() << Q_FUNC_INFO << "Couldn't activate painter on buffer";
+    replotInBackground(true);
+    if (mReplotTimingEnabled)
+      mReplotTimings.replot = timer.nsecsElapsed();
+  } else
+  {
+    mPaintBuffer.fill(mBackgroundBrush.style() == Qt::SolidPattern ? mBackgroundBrush.color() : Qt::transparent);
+    QCPPainter painter;
+    painter.begin(&mPaintBuffer);
+    if (painter.isActive())
+    {
+      painter.setRenderHint(QPainter::HighQualityAntialiasing); // to make Antialiasing look good if using the OpenGL graphicssystem
+      if (mBackgroundBrush.style() != Qt::SolidPattern && mBackgroundBrush.style() != Qt::NoBrush)
+        painter.fillRect(mViewport, mBackgroundBrush);
+      draw(&painter);
+      painter.end();
+      if (mReplotTimingEnabled)
+        mReplotTimings.replot = timer.nsecsElapsed();
+      if ((refreshPriority == rpHint && mPlottingHints.testFlag(QCP::phForceRepaint)) || refreshPriority==rpImmediate)
+        repaint();
+      else
+        update();
+    } else // might happen if QCustomPlot has width or height zero
+      qDebug() << Q_FUNC_INFO << "Couldn't activate painter on buffer";
+  }
   
   emit afterReplot();
   mReplotting = false;
 }
 
+/*!
+  Makes the next replot run the margin and layout phases of the layout system (see \ref
+  QCPLayoutElement::UpdatePhase). Replots that don't affect the layout, like most replots after
+  only data changed, skip these phases and keep the element rects of the previous replot.
+  
+  Changes of the viewport, the layout structure, margins and size constraints of layout elements,
+  and the texts and fonts of legends and plot titles call this automatically. Changed axis margins
+  (due to new tick labels, labels, fonts, visibility etc.) are detected on every replot. Layout
+  elements of your own whose \ref QCPLayoutElement::minimumSizeHint or \ref
+  QCPLayoutElement::maximumSizeHint depend on other properties should call this when those
+  properties change.
+  
+  Calls during the margin and layout phases themselves are ignored.
+*/
+void QCustomPlot::invalidateLayout()
+{
+  if (!mUpdatingLayout)
+    mLayoutValid = false;
+}
+
 /*!
   Rescales the axes such that all plottables (like graphs) in the plot are fully visible.
   
@@ -10692,13 +11302,27 @@ QSize QCustomPlot::sizeHint() const
 /*! \internal
   
   Event handler for when the QCustomPlot widget needs repainting. This does not cause a \ref replot, but
-  draws the internal buffer on the widget surface.
+  draws the internal buffer on the widget surface. With \ref QCP::phBackgroundRaster, that's the
+  newest frame finished by the renderer thread instead, and just the background brush until the
+  first frame is finished.
 */
 void QCustomPlot::paintEvent(QPaintEvent *event)
 {
   Q_UNUSED(event);
+  QElapsedTimer timer;
+  if (mReplotTimingEnabled)
+    timer.start();
   QPainter painter(this);
-  painter.drawPixmap(0, 0, mPaintBuffer);
+  if (mPlottingHints.testFlag(QCP::phBackgroundRaster))
+  {
+    if (!mRenderedFrame.isNull())
+      painter.drawImage(0, 0, mRenderedFrame);
+    else // the paint buffer isn't drawn to in this mode
+      painter.fillRect(rect(), mBackgroundBrush);
+  } else
+    painter.drawPixmap(0, 0, mPaintBuffer);
+  if (mReplotTimingEnabled)
+    mReplotTimings.paint = timer.nsecsElapsed();
 }
 
 /*! \internal
@@ -10911,32 +11535,11 @@ void QCustomPlot::wheelEvent(QWheelEvent *event)
 */
 void QCustomPlot::draw(QCPPainter *painter)
 {
-  // run through layout phases:
-  mPlotLayout->update(QCPLayoutElement::upPreparation);
-  mPlotLayout->update(QCPLayoutElement::upMargins);
-  mPlotLayout->update(QCPLayoutElement::upLayout);
+  updatePlotLayout();
+  drawLayers(painter);
   
-  // draw viewport background pixmap:
-  drawBackground(painter);
-
-  // draw all layered objects (grid, axes, plottables, items, legend,...):
-  foreach (QCPLayer *layer, mLayers)
-  {
-    foreach (QCPLayerable *child, layer->children())
-    {
-      if (child->realVisibility())
-      {
-        painter->save();
-        painter->setClipRect(child->clipRect().translated(0, -1));
-        child->applyDefaultAntialiasingHint(painter);
-        child->draw(painter);
-        painter->restore();
-      }
-    }
-  }
-  
-  /* Debug code to draw all layout element rects
-  foreach (QCPLayoutElement* el, findChildren<QCPLayoutElement*>())
+  /* Debug code to draw all layout element rects
+  foreach (QCPLayoutElement* el, findChildren<QCPLayoutElement*>())
   {
     painter->setBrush(Qt::NoBrush);
     painter->setPen(QPen(QColor(0, 0, 0, 100), 0, Qt::DashLine));
@@ -10947,6 +11550,368 @@ void QCustomPlot::draw(QCPPainter *painter)
   */
 }
 
+/*! \internal
+  
+  Runs through the layout phases before the layers are drawn, see \ref draw. The preparation is
+  done every time, the margin and layout phases only when \ref invalidateLayout was called or the
+  axis margins changed.
+*/
+void QCustomPlot::updatePlotLayout()
+{
+  // see setReplotTimingEnabled:
+  const bool timed = mReplotTimingEnabled;
+  QElapsedTimer timer;
+  if (timed)
+  {
+    mReplotTimings.layers.clear();
+    timer.start();
+  }
+  
+  // run through layout phases. The preparation (tick setup) is needed for every replot, margins and
+  // layout only if something affecting them changed since the last time (see invalidateLayout):
+  mPlotLayout->update(QCPLayoutElement::upPreparation);
+  if (timed) mReplotTimings.preparation = lapNsecs(timer);
+  if (!mLayoutValid || layoutAxisMargins() != mLayoutAxisMargins)
+  {
+    mUpdatingLayout = true;
+    mPlotLayout->update(QCPLayoutElement::upMargins);
+    if (timed) mReplotTimings.margins = lapNsecs(timer);
+    mPlotLayout->update(QCPLayoutElement::upLayout);
+    if (timed) mReplotTimings.layout = lapNsecs(timer);
+    mUpdatingLayout = false;
+    mLayoutAxisMargins = layoutAxisMargins(); // after the layout, which sets the offsets of stacked axes
+    mLayoutValid = true;
+  } else if (timed)
+  {
+    mReplotTimings.margins = lapNsecs(timer);
+    mReplotTimings.layout = 0;
+  }
+}
+
+/*! \internal
+  
+  Draws the viewport background pixmap and all layers on top of it with \a painter, using the
+  current layout. Called by \ref draw after the layout update, and by \ref replotBufferedLayers
+  without one.
+  
+  When drawing into the paint buffer (i.e. during a replot), layers in \ref QCPLayer::lmBuffered
+  mode are redrawn into their own pixmap only if they are marked dirty, and then copied into the
+  paint buffer. Any other target, like the painter of an export, gets every layer drawn directly.
+*/
+void QCustomPlot::drawLayers(QCPPainter *painter)
+{
+  const bool timed = mReplotTimingEnabled;
+  QElapsedTimer timer;
+  if (timed)
+    timer.start();
+  
+  // draw viewport background pixmap:
+  drawBackground(painter);
+  if (timed) mReplotTimings.background = lapNsecs(timer);
+  
+  // compute the line data of all graphs that get drawn in this pass at once:
+  const bool useLayerBuffers = painter->device() == &mPaintBuffer;
+  if (mPlottingHints.testFlag(QCP::phParallelPreparation))
+  {
+    QList<QCPGraph*> graphs;
+    foreach (QCPGraph *graph, mGraphs)
+    {
+      QCPLayer *layer = graph->layer();
+      if (!layer || !graph->realVisibility())
+        continue;
+      if (!useLayerBuffers || layer->mode() != QCPLayer::lmBuffered || layer->mBufferDirty || layer->mBuffer.size() != mPaintBuffer.size())
+        graphs.append(graph);
+    }
+    prepareGraphs(graphs);
+  }
+  if (timed) mReplotTimings.plotData = lapNsecs(timer);
+  
+  // draw all layered objects (grid, axes, plottables, items, legend,...):
+  foreach (QCPLayer *layer, mLayers)
+  {
+    if (useLayerBuffers && layer->mode() == QCPLayer::lmBuffered)
+    {
+      if (layer->mBufferDirty || layer->mBuffer.size() != mPaintBuffer.size())
+      {
+        if (layer->mBuffer.size() != mPaintBuffer.size())
+          layer->mBuffer = QPixmap(mPaintBuffer.size());
+        layer->mBuffer.fill(Qt::transparent);
+        QCPPainter layerPainter;
+        layerPainter.begin(&layer->mBuffer);
+        layerPainter.setRenderHint(QPainter::HighQualityAntialiasing);
+        drawLayer(&layerPainter, layer);
+        layerPainter.end();
+        layer->mBufferDirty = false;
+      }
+      painter->drawPixmap(0, 0, layer->mBuffer);
+    } else
+      drawLayer(painter, layer);
+    if (timed)
+      mReplotTimings.layers.append(qMakePair(layer->name(), lapNsecs(timer)));
+  }
+}
+
+/*! \internal
+  
+  Lets all \a graphs compute their line data for the following draw calls (see \ref
+  QCPGraph::preparePlotData), spread over idle threads of the global QThreadPool and the calling
+  thread. Returns when all graphs are prepared.
+  
+  Workers are only started with QThreadPool::tryStart, so this never waits for pool threads that
+  are busy elsewhere. If none are free, the calling thread prepares all graphs itself.
+*/
+void QCustomPlot::prepareGraphs(const QList<QCPGraph*> &graphs)
+{
+  if (graphs.size() < 2) // a single graph prepares its data in draw, as usual
+    return;
+  
+  QAtomicInt nextIndex(0);
+  QSemaphore finished;
+  QThreadPool *pool = QThreadPool::globalInstance();
+  int started = 0;
+  for (int i=1; i<graphs.size() && i<pool->maxThreadCount(); ++i)
+  {
+    QCPGraphPreparation *worker = new QCPGraphPreparation(&graphs, &nextIndex, &finished);
+    if (pool->tryStart(worker))
+      ++started;
+    else
+    {
+      delete worker;
+      break;
+    }
+  }
+  QCPGraphPreparation(&graphs, &nextIndex, 0).run();
+  finished.acquire(started);
+}
+
+/*! \internal
+  
+  Draws the visible layerables of \a layer with \a painter.
+*/
+void QCustomPlot::drawLayer(QCPPainter *painter, QCPLayer *layer)
+{
+  foreach (QCPLayerable *child, layer->children())
+  {
+    if (child->realVisibility())
+    {
+      painter->save();
+      painter->setClipRect(child->clipRect().translated(0, -1));
+      child->applyDefaultAntialiasingHint(painter);
+      child->draw(painter);
+      painter->restore();
+    }
+  }
+}
+
+/*! \internal
+  
+  Refreshes the plot after only buffered layers changed, see \ref QCPLayer::replot. Like \ref
+  replot, but the layout is not updated and clean buffered layers are copied from their pixmaps
+  instead of being redrawn. The \ref beforeReplot and \ref afterReplot signals are not emitted.
+*/
+void QCustomPlot::replotBufferedLayers()
+{
+  if (mReplotting)
+    return;
+  mReplotting = true;
+  
+  QElapsedTimer timer;
+  if (mReplotTimingEnabled)
+  {
+    timer.start();
+    mReplotTimings.layers.clear();
+    mReplotTimings.preparation = 0;
+    mReplotTimings.margins = 0;
+    mReplotTimings.layout = 0;
+  }
+  
+  if (mPlottingHints.testFlag(QCP::phBackgroundRaster))
+  {
+    replotInBackground(false);
+    if (mReplotTimingEnabled)
+      mReplotTimings.replot = timer.nsecsElapsed();
+  } else
+  {
+    mPaintBuffer.fill(mBackgroundBrush.style() == Qt::SolidPattern ? mBackgroundBrush.color() : Qt::transparent);
+    QCPPainter painter;
+    painter.begin(&mPaintBuffer);
+    if (painter.isActive())
+    {
+      painter.setRenderHint(QPainter::HighQualityAntialiasing);
+      if (mBackgroundBrush.style() != Qt::SolidPattern && mBackgroundBrush.style() != Qt::NoBrush)
+        painter.fillRect(mViewport, mBackgroundBrush);
+      drawLayers(&painter);
+      painter.end();
+      if (mReplotTimingEnabled)
+        mReplotTimings.replot = timer.nsecsElapsed();
+      update();
+    } else
+      qDebug() << Q_FUNC_INFO << "Couldn't activate painter on buffer";
+  }
+  
+  mReplotting = false;
+}
+
+/*! \internal
+  
+  Replot path for \ref QCP::phBackgroundRaster, used by \ref replot and (with \a withLayout
+  false) by \ref replotBufferedLayers. The plot is drawn into QPictures on this thread, which
+  includes the layout and the computation of all line data, and the pictures are handed to the
+  renderer thread for the rasterization, which is the expensive part with long or antialiased
+  lines. Nothing waits for the result; \ref frameRendered refreshes the widget once it's there.
+  
+  Buffered layers take the place of their pixmaps in this mode: the renderer keeps an image of
+  each, and only the dirty ones are recorded and rasterized again. Consecutive logical layers (and
+  the background) share one picture that is recorded every time. Pixmaps belong to the GUI thread,
+  so label pixmap caching is switched off for the recording, and other pixmaps are recorded as
+  QImages (see \ref QCPPainter::pmNoPixmaps).
+*/
+void QCustomPlot::replotInBackground(bool withLayout)
+{
+  if (withLayout)
+    updatePlotLayout();
+  
+  const bool timed = mReplotTimingEnabled;
+  QElapsedTimer timer;
+  if (timed)
+    timer.start();
+  
+  // the renderer's layer images are indexed by layer and have the size of the widget:
+  if (mRasterSize != mPaintBuffer.size() || mRasterLayers != mLayers)
+  {
+    foreach (QCPLayer *layer, mLayers)
+      layer->mBufferDirty = true;
+    mRasterSize = mPaintBuffer.size();
+    mRasterLayers = mLayers;
+  }
+  
+  // compute the line data of all graphs that get recorded in this pass at once:
+  if (mPlottingHints.testFlag(QCP::phParallelPreparation))
+  {
+    QList<QCPGraph*> graphs;
+    foreach (QCPGraph *graph, mGraphs)
+    {
+      QCPLayer *layer = graph->layer();
+      if (layer && graph->realVisibility() && (layer->mode() != QCPLayer::lmBuffered || layer->mBufferDirty))
+        graphs.append(graph);
+    }
+    prepareGraphs(graphs);
+  }
+  if (timed) mReplotTimings.plotData = lapNsecs(timer);
+  
+  QList<QCPFrameRenderer::Part> parts;
+  parts.append(QCPFrameRenderer::Part());
+  QCPPainter painter;
+  painter.begin(&parts.last().picture);
+  painter.setModes(QCPPainter::pmNoCaching|QCPPainter::pmNoPixmaps);
+  painter.setRenderHint(QPainter::HighQualityAntialiasing);
+  if (mBackgroundBrush.style() != Qt::SolidPattern && mBackgroundBrush.style() != Qt::NoBrush)
+  {
+    painter.setBrush(mBackgroundBrush); // converts a pixmap texture
+    painter.fillRect(mViewport, painter.brush());
+    painter.setBrush(Qt::NoBrush);
+  }
+  drawBackground(&painter);
+  if (timed) mReplotTimings.background = lapNsecs(timer);
+  
+  for (int i=0; i<mLayers.size(); ++i)
+  {
+    QCPLayer *layer = mLayers.at(i);
+    if (layer->mode() == QCPLayer::lmBuffered)
+    {
+      if (painter.isActive())
+        painter.end();
+      QCPFrameRenderer::Part part;
+      part.slot = i;
+      if (layer->mBufferDirty)
+      {
+        QCPPainter layerPainter;
+        layerPainter.begin(&part.picture);
+        layerPainter.setModes(QCPPainter::pmNoCaching|QCPPainter::pmNoPixmaps);
+        layerPainter.setRenderHint(QPainter::HighQualityAntialiasing);
+        drawLayer(&layerPainter, layer);
+        layerPainter.end();
+        part.hasPicture = true;
+        layer->mBufferDirty = false; // its pixmap isn't, but setPlottingHints takes care of that
+      }
+      parts.append(part);
+    } else
+    {
+      if (!painter.isActive())
+      {
+        parts.append(QCPFrameRenderer::Part());
+        painter.begin(&parts.last().picture);
+        painter.setModes(QCPPainter::pmNoCaching|QCPPainter::pmNoPixmaps);
+        painter.setRenderHint(QPainter::HighQualityAntialiasing);
+      }
+      drawLayer(&painter, layer);
+    }
+    if (timed)
+      mReplotTimings.layers.append(qMakePair(layer->name(), lapNsecs(timer)));
+  }
+  if (painter.isActive())
+    painter.end();
+  
+  if (!mFrameRenderer)
+  {
+    mFrameRenderer = new QCPFrameRenderer(this);
+    connect(mFrameRenderer, SIGNAL(frameReady()), this, SLOT(frameRendered()), Qt::QueuedConnection);
+    mFrameRenderer->start();
+  }
+  mFrameRenderer->submit(parts, mPaintBuffer.size(), mBackgroundBrush.style() == Qt::SolidPattern ? mBackgroundBrush.color() : QColor(Qt::transparent));
+}
+
+/*! \internal
+  
+  Called (queued) when the renderer thread finished a frame. Takes the frame and schedules a paint
+  event to show it. Frames that were finished while this was waiting in the event queue are
+  skipped, only the newest one is shown.
+*/
+void QCustomPlot::frameRendered()
+{
+  if (mFrameRenderer && mFrameRenderer->takeFrame(&mRenderedFrame))
+    update();
+}
+
+/*! \internal
+  
+  Returns the type, offset and margin (\ref QCPAxis::calculateMargin) of every axis in the plot
+  layout, including the axes of color scales. \ref draw compares this to the values of the last
+  layout pass to find out whether the axes need different margins, e.g. because the tick labels got
+  wider after a range change. The margins are cached in the axes, so this is cheap while they don't
+  change.
+*/
+QVector<int> QCustomPlot::layoutAxisMargins()
+{
+  QVector<int> result;
+  foreach (QCPLayoutElement *element, mPlotLayout->elements(true))
+  {
+    QList<QCPAxis*> axes;
+    if (QCPAxisRect *axisRect = qobject_cast<QCPAxisRect*>(element))
+      axes = axisRect->axes();
+    else if (QCPColorScale *colorScale = qobject_cast<QCPColorScale*>(element))
+      axes << colorScale->axis();
+    foreach (QCPAxis *axis, axes)
+    {
+      if (axis)
+        result << axis->axisType() << axis->offset() << axis->calculateMargin();
+    }
+  }
+  return result;
+}
+
+/*! \internal
+  
+  Returns the nanoseconds elapsed on \a timer and restarts it. Used by \ref draw to time the
+  consecutive phases of a replot.
+*/
+qint64 QCustomPlot::lapNsecs(QElapsedTimer &timer)
+{
+  qint64 elapsed = timer.nsecsElapsed();
+  timer.start();
+  return elapsed;
+}
+
 /*! \internal
   
   Draws the viewport background pixmap of the plot.
@@ -12677,6 +13642,8 @@ QCPAbstractLegendItem::QCPAbstractLegendItem(QCPLegend *parent) :
 void QCPAbstractLegendItem::setFont(const QFont &font)
 {
   mFont = font;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -12698,6 +13665,8 @@ void QCPAbstractLegendItem::setTextColor(const QColor &color)
 void QCPAbstractLegendItem::setSelectedFont(const QFont &font)
 {
   mSelectedFont = font;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -12739,6 +13708,8 @@ void QCPAbstractLegendItem::setSelected(bool selected)
   {
     mSelected = selected;
     emit selectionChanged(mSelected);
+    if (mParentPlot)
+      mParentPlot->invalidateLayout(); // the selected font may have a different size
   }
 }
 
@@ -13071,6 +14042,8 @@ void QCPLegend::setTextColor(const QColor &color)
 void QCPLegend::setIconSize(const QSize &size)
 {
   mIconSize = size;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*! \overload
@@ -13079,6 +14052,8 @@ void QCPLegend::setIconSize(int width, int height)
 {
   mIconSize.setWidth(width);
   mIconSize.setHeight(height);
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -13089,6 +14064,8 @@ void QCPLegend::setIconSize(int width, int height)
 void QCPLegend::setIconTextPadding(int padding)
 {
   mIconTextPadding = padding;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -13568,6 +14545,8 @@ QCPPlotTitle::QCPPlotTitle(QCustomPlot *parentPlot, const QString &text) :
 void QCPPlotTitle::setText(const QString &text)
 {
   mText = text;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -13578,6 +14557,8 @@ void QCPPlotTitle::setText(const QString &text)
 void QCPPlotTitle::setFont(const QFont &font)
 {
   mFont = font;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -13935,6 +14916,8 @@ void QCPColorScale::setType(QCPAxis::AxisType type)
     mAxisRect.data()->setRangeDragAxes(QCPAxis::orientation(mType) == Qt::Horizontal ? mColorAxis.data() : 0,
                                        QCPAxis::orientation(mType) == Qt::Vertical ? mColorAxis.data() : 0);
   }
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -14020,6 +15003,8 @@ void QCPColorScale::setLabel(const QString &str)
 void QCPColorScale::setBarWidth(int width)
 {
   mBarWidth = width;
+  if (mParentPlot)
+    mParentPlot->invalidateLayout();
 }
 
 /*!
@@ -14438,128 +15423,793 @@ QCPData::QCPData(double key, double value) :
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////// QCPGraph
+//////////////////// QCPDataVector
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-/*! \class QCPGraph
-  \brief A plottable representing a graph in a plot.
-
-  \image html QCPGraph.png
+/*! \class QCPDataVector
+  \brief Contiguous, key-sorted storage for the data points of a QCPGraph.
   
-  Usually QCustomPlot creates graphs internally via QCustomPlot::addGraph and the resulting
-  instance is accessed via QCustomPlot::graph.
-
-  To plot data, assign it with the \ref setData or \ref addData functions. Alternatively, you can
-  also access and modify the graph's data via the \ref data method, which returns a pointer to the
-  internal \ref QCPDataMap.
+  Holds the same information as a \ref QCPDataMap, but keys and values are kept in two plain
+  arrays sorted by key. Compared to the map this needs no allocation per data point, uses about a
+  sixth of the memory when no errors are set, and is walked front to back during a replot instead
+  of chasing tree nodes. Visible ranges are found with a binary search (\ref lowerBound, \ref
+  upperBound).
   
-  Graphs are used to display single-valued data. Single-valued means that there should only be one
-  data point per unique key coordinate. In other words, the graph can't have \a loops. If you do
-  want to plot non-single-valued curves, rather use the QCPCurve plottable.
+  For drawing many points per pixel, the vector keeps a min/max pyramid of its values: level 0
+  holds the minimum and maximum of every 16 consecutive values, each further level those of 16
+  entries of the level below. \ref valueBounds uses it to find the value span of any index range in
+  logarithmic time, which lets QCPGraph's adaptive sampling cost the same per pixel however many
+  points a pixel covers. The pyramid needs about an eighth of the memory of the values. It is
+  brought up to date on the next query only, and only from the first point that changed, so
+  appending data keeps its constant cost.
   
-  \section appearance Changing the appearance
+  The four error arrays are only allocated once a data point with a non-zero error is added, so
+  pure key/value data costs two doubles per point.
   
-  The appearance of the graph is mainly determined by the line style, scatter style, brush and pen
-  of the graph (\ref setLineStyle, \ref setScatterStyle, \ref setBrush, \ref setPen).
+  Removing points from the front (\ref removeBefore, or a \ref setCapacity limit) doesn't move
+  the remaining points: the arrays start at an offset that is simply advanced. The removed entries
+  are dropped in one move once there are as many of them as present points, so front removal is
+  amortized constant per point and the arrays never hold more than twice the present points. With
+  a capacity set, the vector is a fixed-size sliding window, like a ring buffer that stays
+  contiguous for binary searches and the min/max pyramid.
   
-  \subsection filling Filling under or between graphs
+  Data points with equal keys keep the order in which they were added. Adding a point with a key
+  larger than or equal to all present keys is an amortized constant time append, no matter how
+  many points the vector already holds; inserting in the middle moves the following points, so this
+  container is meant for data that mostly arrives in key order, like measurements over time. Blocks
+  of such data are best added with \ref appendSorted.
   
-  QCPGraph knows two types of fills: Normal graph fills towards the zero-value-line parallel to
-  the key axis of the graph, and fills between two graphs, called channel fills. To enable a fill,
-  just set a brush with \ref setBrush which is neither Qt::NoBrush nor fully transparent.
+  A graph uses this container instead of its \ref QCPDataMap after \ref
+  QCPGraph::setDataStorage "QCPGraph::setDataStorage(QCPGraph::dsVector)", see \ref
+  QCPGraph::vectorData.
   
-  By default, a normal fill towards the zero-value-line will be drawn. To set up a channel fill
-  between this graph and another one, call \ref setChannelFillGraph with the other graph as
-  parameter.
-
-  \see QCustomPlot::addGraph, QCustomPlot::graph, QCPLegend::addGraph
+  \see QCPData, QCPDataMap
 */
 
 /* start of documentation of inline functions */
 
-/*! \fn QCPDataMap *QCPGraph::data() const
+/*! \fn QCPDataVector::const_iterator QCPDataVector::lowerBound(double key) const
   
-  Returns a pointer to the internal data storage of type \ref QCPDataMap. You may use it to
-  directly manipulate the data, which may be more convenient and faster than using the regular \ref
-  setData or \ref addData methods, in certain situations.
+  Returns an iterator to the first data point whose key is not smaller than \a key, or \ref
+  constEnd if there is none. Same semantics as QMap::lowerBound.
 */
 
-/* end of documentation of inline functions */
-
-/*!
-  Constructs a graph which uses \a keyAxis as its key axis ("x") and \a valueAxis as its value
-  axis ("y"). \a keyAxis and \a valueAxis must reside in the same QCustomPlot instance and not have
-  the same orientation. If either of these restrictions is violated, a corresponding message is
-  printed to the debug output (qDebug), the construction is not aborted, though.
-  
-  The constructed QCPGraph can be added to the plot with QCustomPlot::addPlottable, QCustomPlot
-  then takes ownership of the graph.
+/*! \fn QCPDataVector::const_iterator QCPDataVector::upperBound(double key) const
   
-  To directly create a graph inside a plot, you can also use the simpler QCustomPlot::addGraph function.
+  Returns an iterator to the first data point whose key is greater than \a key, or \ref constEnd if
+  there is none. Same semantics as QMap::upperBound.
 */
-QCPGraph::QCPGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) :
-  QCPAbstractPlottable(keyAxis, valueAxis)
-{
-  mData = new QCPDataMap;
-  
-  setPen(QPen(Qt::blue, 0));
-  setErrorPen(QPen(Qt::black));
-  setBrush(Qt::NoBrush);
-  setSelectedPen(QPen(QColor(80, 80, 255), 2.5));
-  setSelectedBrush(Qt::NoBrush);
+
+/*! \fn bool QCPDataVector::hasErrors() const
   
-  setLineStyle(lsLine);
-  setErrorType(etNone);
-  setErrorBarSize(6);
-  setErrorBarSkipSymbol(true);
-  setChannelFillGraph(0);
-  setAdaptiveSampling(true);
-}
+  Returns whether the error arrays are allocated, i.e. whether any data point with non-zero errors
+  was added since the last \ref clear.
+*/
 
-QCPGraph::~QCPGraph()
+/* end of documentation of inline functions */
+
+/*!
+  Constructs an empty data vector.
+*/
+QCPDataVector::QCPDataVector() :
+  mCapacity(0),
+  mBegin(0),
+  mLodValidSize(0)
 {
-  delete mData;
 }
 
 /*!
-  Replaces the current data with the provided \a data.
-  
-  If \a copy is set to true, data points in \a data will only be copied. if false, the graph
-  takes ownership of the passed data and replaces the internal data pointer with it. This is
-  significantly faster than copying for large datasets.
+  Limits the vector to \a capacity data points, 0 (the default) means no limit. While the limit
+  is set, adding points beyond it removes the points with the smallest keys, i.e. the oldest ones
+  when data is recorded over time. Points that are already beyond the limit are removed right
+  away.
   
-  Alternatively, you can also access and modify the graph's data via the \ref data method, which
-  returns a pointer to the internal \ref QCPDataMap.
+  Room for twice \a capacity points is reserved once, so streaming into a vector with a capacity
+  never allocates and keeps a fixed memory footprint. Removing the oldest points costs constant
+  time; every \a capacity appended points, the present points are moved to the start of the
+  arrays in one block.
 */
-void QCPGraph::setData(QCPDataMap *data, bool copy)
+void QCPDataVector::setCapacity(int capacity)
 {
-  if (copy)
+  mCapacity = qMax(0, capacity);
+  evict();
+  if (mCapacity > 0)
   {
-    *mData = *data;
-  } else
-  {
-    delete mData;
-    mData = data;
+    compact();
+    reserve(2*mCapacity);
   }
 }
 
-/*! \overload
-  
-  Replaces the current data with the provided points in \a key and \a value pairs. The provided
-  vectors should have equal length. Else, the number of added points will be the size of the
-  smallest vector.
+/*!
+  Returns the data point at \a index as a \ref QCPData. \a index must be valid.
 */
-void QCPGraph::setData(const QVector<double> &key, const QVector<double> &value)
+QCPData QCPDataVector::at(int index) const
 {
-  mData->clear();
-  int n = key.size();
-  n = qMin(n, value.size());
-  QCPData newData;
-  for (int i=0; i<n; ++i)
+  index += mBegin;
+  QCPData result(mKeys.at(index), mValues.at(index));
+  if (hasErrors())
   {
-    newData.key = key[i];
-    newData.value = value[i];
-    mData->insertMulti(newData.key, newData);
+    result.keyErrorPlus = mKeyErrorsPlus.at(index);
+    result.keyErrorMinus = mKeyErrorsMinus.at(index);
+    result.valueErrorPlus = mValueErrorsPlus.at(index);
+    result.valueErrorMinus = mValueErrorsMinus.at(index);
+  }
+  return result;
+}
+
+/*!
+  Returns the index of the first data point whose key is not smaller than \a key, or \ref size if
+  there is none.
+*/
+int QCPDataVector::lowerBoundIndex(double key) const
+{
+  return std::lower_bound(mKeys.constBegin()+mBegin, mKeys.constEnd(), key)-(mKeys.constBegin()+mBegin);
+}
+
+/*!
+  Returns the index of the first data point whose key is greater than \a key, or \ref size if
+  there is none.
+*/
+int QCPDataVector::upperBoundIndex(double key) const
+{
+  return std::upper_bound(mKeys.constBegin()+mBegin, mKeys.constEnd(), key)-(mKeys.constBegin()+mBegin);
+}
+
+/*!
+  Removes all data points and releases the error arrays. The capacity (\ref setCapacity) stays.
+*/
+void QCPDataVector::clear()
+{
+  mBegin = 0;
+  mKeys.clear();
+  mValues.clear();
+  mKeyErrorsPlus.clear();
+  mKeyErrorsMinus.clear();
+  mValueErrorsPlus.clear();
+  mValueErrorsMinus.clear();
+  mLodMin.clear();
+  mLodMax.clear();
+  mLodValidSize = 0;
+  if (mCapacity > 0)
+    reserve(2*mCapacity);
+}
+
+/*!
+  Reserves room for \a size data points, so that many points can be added without reallocating.
+*/
+void QCPDataVector::reserve(int size)
+{
+  size += mBegin;
+  mKeys.reserve(size);
+  mValues.reserve(size);
+  if (hasErrors())
+  {
+    mKeyErrorsPlus.reserve(size);
+    mKeyErrorsMinus.reserve(size);
+    mValueErrorsPlus.reserve(size);
+    mValueErrorsMinus.reserve(size);
+  }
+}
+
+/*!
+  Replaces the current data with the points given as \a keys and \a values pairs. If the vectors
+  differ in length, the number of points is the size of the smaller one.
+  
+  Already sorted \a keys (the usual case) are taken over as they are. Otherwise the points are
+  sorted by key, keeping points with equal keys in their given order. With a capacity set, only the
+  points with the largest keys are kept.
+*/
+void QCPDataVector::set(const QVector<double> &keys, const QVector<double> &values)
+{
+  clear();
+  int n = qMin(keys.size(), values.size());
+  mKeys = keys;
+  mValues = values;
+  mKeys.resize(n);
+  mValues.resize(n);
+  
+  bool sorted = true;
+  for (int i=1; i<n && sorted; ++i)
+    sorted = !(mKeys.at(i) < mKeys.at(i-1));
+  if (sorted)
+  {
+    evict();
+    return;
+  }
+  
+  // sorting (key, original index) pairs keeps equal keys in their given order:
+  QVector<QPair<double, int> > order(n);
+  for (int i=0; i<n; ++i)
+    order[i] = qMakePair(mKeys.at(i), i);
+  std::sort(order.begin(), order.end());
+  QVector<double> sortedValues(n);
+  for (int i=0; i<n; ++i)
+  {
+    mKeys[i] = order.at(i).first;
+    sortedValues[i] = mValues.at(order.at(i).second);
+  }
+  mValues = sortedValues;
+  evict();
+}
+
+/*!
+  Adds the data point \a data, behind all points with a key smaller than or equal to its key. If
+  it has non-zero errors, the error arrays are allocated (see \ref hasErrors).
+*/
+void QCPDataVector::add(const QCPData &data)
+{
+  insert(insertIndex(data.key), data);
+  evict();
+}
+
+/*! \overload
+  
+  Adds a data point with \a key and \a value and no errors.
+*/
+void QCPDataVector::add(double key, double value)
+{
+  insert(insertIndex(key), QCPData(key, value));
+  evict();
+}
+
+/*! \overload
+  
+  Adds the data points given as \a keys and \a values pairs. If the vectors differ in length, the
+  number of added points is the size of the smaller one.
+  
+  If \a keys are sorted and continue behind the present data, they are appended as one block, see
+  \ref appendSorted. Checking this costs one pass over \a keys.
+*/
+void QCPDataVector::add(const QVector<double> &keys, const QVector<double> &values)
+{
+  int n = qMin(keys.size(), values.size());
+  bool sorted = true;
+  for (int i=1; i<n && sorted; ++i)
+    sorted = !(keys.at(i) < keys.at(i-1));
+  if (sorted)
+  {
+    appendSorted(keys.constData(), values.constData(), n);
+    return;
+  }
+  reserve(size()+n);
+  for (int i=0; i<n; ++i)
+    insert(insertIndex(keys.at(i)), QCPData(keys.at(i), values.at(i)));
+  evict();
+}
+
+/*! \overload
+  
+  Adds all data points of \a dataMap.
+*/
+void QCPDataVector::add(const QCPDataMap &dataMap)
+{
+  reserve(size()+dataMap.size());
+  QCPDataMap::const_iterator it;
+  for (it = dataMap.constBegin(); it != dataMap.constEnd(); ++it)
+  {
+    QCPData data = it.value();
+    data.key = it.key();
+    insert(insertIndex(data.key), data);
+  }
+  evict();
+}
+
+/*!
+  Appends \a count data points given as \a keys and \a values arrays, without any per-point search or
+  allocation: the arrays are copied as one block and the storage grows geometrically, so streaming
+  data into the vector costs the same per point whether it holds a thousand or ten million points.
+  
+  \a keys must be sorted ascending. This is not checked, unsorted keys break all key lookups of the
+  vector. The only check is whether the first key continues behind the present data; if it
+  doesn't, the points are inserted one by one at their sorted positions instead.
+  
+  Points with errors can't be appended this way. If the vector already holds errors (\ref
+  hasErrors), the appended points get zero errors.
+  
+  With a capacity set (\ref setCapacity), the points that the new ones push out are dropped
+  before copying, and of more new points than fit only the last ones are copied.
+*/
+void QCPDataVector::appendSorted(const double *keys, const double *values, int count)
+{
+  if (count <= 0) return;
+  if (!isEmpty() && keys[0] < mKeys.at(mKeys.size()-1))
+  {
+    for (int i=0; i<count; ++i)
+      insert(insertIndex(keys[i]), QCPData(keys[i], values[i]));
+    evict();
+    return;
+  }
+  
+  if (mCapacity > 0)
+  {
+    if (count > mCapacity)
+    {
+      keys += count-mCapacity;
+      values += count-mCapacity;
+      count = mCapacity;
+    }
+    mBegin += qMax(0, size()+count-mCapacity);
+    if (mKeys.size()+count > 2*mCapacity) // reserved room used up, move the remaining points to the front
+      compact();
+  }
+  
+  int oldSize = mKeys.size();
+  int newSize = oldSize+count;
+  if (newSize > mKeys.capacity())
+    reserve(qMax(newSize, 2*mKeys.capacity())-mBegin); // geometric growth keeps repeated small appends amortized constant
+  mKeys.resize(newSize);
+  mValues.resize(newSize);
+  memcpy(mKeys.data()+oldSize, keys, count*sizeof(double));
+  memcpy(mValues.data()+oldSize, values, count*sizeof(double));
+  if (hasErrors())
+  {
+    mKeyErrorsPlus.resize(newSize); // new entries are zero-initialized
+    mKeyErrorsMinus.resize(newSize);
+    mValueErrorsPlus.resize(newSize);
+    mValueErrorsMinus.resize(newSize);
+  }
+  evict();
+}
+
+/*! \overload
+  
+  Appends the data points given as \a keys and \a values vectors. If the vectors differ in length,
+  the number of appended points is the size of the smaller one.
+*/
+void QCPDataVector::appendSorted(const QVector<double> &keys, const QVector<double> &values)
+{
+  appendSorted(keys.constData(), values.constData(), qMin(keys.size(), values.size()));
+}
+
+/*!
+  Removes all data points with keys smaller than \a key.
+*/
+void QCPDataVector::removeBefore(double key)
+{
+  removeRange(0, lowerBoundIndex(key));
+}
+
+/*!
+  Removes all data points with keys greater than \a key.
+*/
+void QCPDataVector::removeAfter(double key)
+{
+  removeRange(upperBoundIndex(key), size());
+}
+
+/*!
+  Removes all data points with keys greater than \a fromKey and smaller than or equal to \a toKey,
+  the same points QCPGraph::removeData(double fromKey, double toKey) removes from a \ref QCPDataMap.
+  If \a fromKey is greater or equal to \a toKey, nothing is removed.
+*/
+void QCPDataVector::remove(double fromKey, double toKey)
+{
+  if (fromKey >= toKey) return;
+  removeRange(upperBoundIndex(fromKey), upperBoundIndex(toKey));
+}
+
+/*! \overload
+  
+  Removes all data points whose key is exactly \a key.
+*/
+void QCPDataVector::remove(double key)
+{
+  removeRange(lowerBoundIndex(key), upperBoundIndex(key));
+}
+
+/*!
+  Returns the data points as a \ref QCPDataMap.
+*/
+QCPDataMap QCPDataVector::toMap() const
+{
+  QCPDataMap result;
+  for (int i=0; i<size(); ++i)
+    result.insertMulti(key(i), at(i));
+  return result;
+}
+
+/*!
+  Replaces the current data with the data points of \a dataMap.
+*/
+void QCPDataVector::fromMap(const QCPDataMap &dataMap)
+{
+  clear();
+  add(dataMap);
+}
+
+/*! \internal
+  
+  Returns the index a new point with \a key is inserted at, behind all points with smaller or equal
+  keys. Keys continuing behind the present data, as they do when data is recorded, are recognized
+  in constant time without a search.
+*/
+int QCPDataVector::insertIndex(double key) const
+{
+  if (isEmpty() || !(key < mKeys.at(mKeys.size()-1)))
+    return size();
+  return upperBoundIndex(key);
+}
+
+/*! \internal
+  
+  Inserts \a data in front of the point at \a index, allocating the error arrays first if \a data
+  is the first point with errors.
+*/
+void QCPDataVector::insert(int index, const QCPData &data)
+{
+  bool errors = hasErrors() || data.keyErrorPlus != 0 || data.keyErrorMinus != 0 || data.valueErrorPlus != 0 || data.valueErrorMinus != 0;
+  if (errors && !hasErrors())
+    allocateErrors();
+  index += mBegin;
+  invalidateLod(index);
+  
+  if (index == mKeys.size()) // data arriving in key order only ever takes this branch
+  {
+    mKeys.append(data.key);
+    mValues.append(data.value);
+  } else
+  {
+    mKeys.insert(index, data.key);
+    mValues.insert(index, data.value);
+  }
+  if (errors)
+  {
+    mKeyErrorsPlus.insert(index, data.keyErrorPlus);
+    mKeyErrorsMinus.insert(index, data.keyErrorMinus);
+    mValueErrorsPlus.insert(index, data.valueErrorPlus);
+    mValueErrorsMinus.insert(index, data.valueErrorMinus);
+  }
+}
+
+/*! \internal
+  
+  Removes the data points with indices \a from up to, but not including, \a to. Points at the
+  front are removed by advancing the start offset of the arrays, see \ref evict.
+*/
+void QCPDataVector::removeRange(int from, int to)
+{
+  if (from >= to) return;
+  if (from == 0)
+  {
+    mBegin += to;
+    evict();
+    return;
+  }
+  from += mBegin;
+  to += mBegin;
+  invalidateLod(from);
+  mKeys.remove(from, to-from);
+  mValues.remove(from, to-from);
+  if (hasErrors())
+  {
+    mKeyErrorsPlus.remove(from, to-from);
+    mKeyErrorsMinus.remove(from, to-from);
+    mValueErrorsPlus.remove(from, to-from);
+    mValueErrorsMinus.remove(from, to-from);
+  }
+}
+
+/*! \internal
+  
+  Drops the points with the smallest keys beyond the capacity (\ref setCapacity) by advancing the
+  start offset, and compacts the arrays once the entries in front of the offset are at least as
+  many as the present points. Called after every change that adds or removes points.
+*/
+void QCPDataVector::evict()
+{
+  if (mCapacity > 0 && size() > mCapacity)
+    mBegin = mKeys.size()-mCapacity;
+  if (mBegin > 0 && mBegin >= size())
+    compact();
+}
+
+/*! \internal
+  
+  Moves the present points to the start of the arrays, discarding the removed entries in front of
+  them. The arrays keep their allocation. The min/max pyramid is rebuilt on the next query, since
+  its blocks are aligned to array positions.
+*/
+void QCPDataVector::compact()
+{
+  if (mBegin == 0)
+    return;
+  mKeys.remove(0, mBegin);
+  mValues.remove(0, mBegin);
+  if (hasErrors())
+  {
+    mKeyErrorsPlus.remove(0, mBegin);
+    mKeyErrorsMinus.remove(0, mBegin);
+    mValueErrorsPlus.remove(0, mBegin);
+    mValueErrorsMinus.remove(0, mBegin);
+  }
+  mBegin = 0;
+  mLodValidSize = 0;
+}
+
+/*! \internal
+  
+  Creates the error arrays with a zero error for every present data point.
+*/
+void QCPDataVector::allocateErrors()
+{
+  mKeyErrorsPlus.fill(0, mKeys.size());
+  mKeyErrorsMinus.fill(0, mKeys.size());
+  mValueErrorsPlus.fill(0, mKeys.size());
+  mValueErrorsMinus.fill(0, mKeys.size());
+}
+
+/*!
+  Returns the smallest and largest value of the data points with indices \a from up to, but not
+  including, \a to in \a minValue and \a maxValue. The range must hold at least one point.
+  
+  Whole blocks of the range are looked up in the min/max pyramid (see the class description), so
+  only a few dozen entries are compared regardless of the length of the range.
+*/
+void QCPDataVector::valueBounds(int from, int to, double &minValue, double &maxValue) const
+{
+  updateLod();
+  from += mBegin;
+  to += mBegin;
+  minValue = mValues.at(from);
+  maxValue = minValue;
+  
+  const double *mins = mValues.constData();
+  const double *maxs = mValues.constData();
+  int level = 0;
+  while (true)
+  {
+    // at the top of the pyramid or with few entries left, compare them directly:
+    if (level == mLodMin.size() || to-from < 32)
+    {
+      for (int i=from; i<to; ++i)
+      {
+        if (mins[i] < minValue) minValue = mins[i];
+        if (maxs[i] > maxValue) maxValue = maxs[i];
+      }
+      return;
+    }
+    // compare the entries outside whole blocks, then continue with the blocks one level up:
+    for (; from & 15; ++from)
+    {
+      if (mins[from] < minValue) minValue = mins[from];
+      if (maxs[from] > maxValue) maxValue = maxs[from];
+    }
+    for (; to & 15; --to)
+    {
+      if (mins[to-1] < minValue) minValue = mins[to-1];
+      if (maxs[to-1] > maxValue) maxValue = maxs[to-1];
+    }
+    from >>= 4;
+    to >>= 4;
+    mins = mLodMin.at(level).constData();
+    maxs = mLodMax.at(level).constData();
+    ++level;
+  }
+}
+
+/*! \internal
+  
+  Brings the min/max pyramid up to date, recomputing only the blocks that cover array entries from
+  \a mLodValidSize on. After appends these are the last, partially filled blocks and the new ones.
+  The pyramid covers the whole arrays, including removed entries in front of the start offset.
+*/
+void QCPDataVector::updateLod() const
+{
+  int n = mValues.size();
+  if (mLodValidSize == n)
+    return;
+  
+  int levels = 0;
+  for (int size = n; size > 16; size = (size+15) >> 4)
+    ++levels;
+  mLodMin.resize(levels);
+  mLodMax.resize(levels);
+  
+  const double *lowerMins = mValues.constData();
+  const double *lowerMaxs = mValues.constData();
+  int lowerSize = n;
+  int first = mLodValidSize >> 4; // first block to recompute on the current level
+  for (int level=0; level<levels; ++level)
+  {
+    int blocks = (lowerSize+15) >> 4;
+    QVector<double> &mins = mLodMin[level];
+    QVector<double> &maxs = mLodMax[level];
+    first = qMin(first, mins.size()); // a level that didn't exist or was shorter has no valid blocks beyond its old end
+    mins.resize(blocks);
+    maxs.resize(blocks);
+    double *minData = mins.data();
+    double *maxData = maxs.data();
+    for (int b=first; b<blocks; ++b)
+    {
+      int begin = b << 4;
+      int end = qMin(begin+16, lowerSize);
+      double minValue = lowerMins[begin];
+      double maxValue = lowerMaxs[begin];
+      for (int i=begin+1; i<end; ++i)
+      {
+        if (lowerMins[i] < minValue) minValue = lowerMins[i];
+        if (lowerMaxs[i] > maxValue) maxValue = lowerMaxs[i];
+      }
+      minData[b] = minValue;
+      maxData[b] = maxValue;
+    }
+    lowerMins = minData;
+    lowerMaxs = maxData;
+    lowerSize = blocks;
+    first >>= 4;
+  }
+  mLodValidSize = n;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPGraph
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPGraph
+  \brief A plottable representing a graph in a plot.
+
+  \image html QCPGraph.png
+  
+  Usually QCustomPlot creates graphs internally via QCustomPlot::addGraph and the resulting
+  instance is accessed via QCustomPlot::graph.
+
+  To plot data, assign it with the \ref setData or \ref addData functions. Alternatively, you can
+  also access and modify the graph's data via the \ref data method, which returns a pointer to the
+  internal \ref QCPDataMap.
+  
+  For large data sets, e.g. long measurements with millions of points, switch the graph to
+  contiguous storage with \ref setDataStorage "setDataStorage(dsVector)". The data is then held in
+  a \ref QCPDataVector (see \ref vectorData) instead of the map. All \ref setData, \ref addData and
+  \ref removeData functions work the same in both modes.
+  
+  Graphs are used to display single-valued data. Single-valued means that there should only be one
+  data point per unique key coordinate. In other words, the graph can't have \a loops. If you do
+  want to plot non-single-valued curves, rather use the QCPCurve plottable.
+  
+  \section appearance Changing the appearance
+  
+  The appearance of the graph is mainly determined by the line style, scatter style, brush and pen
+  of the graph (\ref setLineStyle, \ref setScatterStyle, \ref setBrush, \ref setPen).
+  
+  \subsection filling Filling under or between graphs
+  
+  QCPGraph knows two types of fills: Normal graph fills towards the zero-value-line parallel to
+  the key axis of the graph, and fills between two graphs, called channel fills. To enable a fill,
+  just set a brush with \ref setBrush which is neither Qt::NoBrush nor fully transparent.
+  
+  By default, a normal fill towards the zero-value-line will be drawn. To set up a channel fill
+  between this graph and another one, call \ref setChannelFillGraph with the other graph as
+  parameter.
+
+  \see QCustomPlot::addGraph, QCustomPlot::graph, QCPLegend::addGraph
+*/
+
+/* start of documentation of inline functions */
+
+/*! \fn QCPDataMap *QCPGraph::data() const
+  
+  Returns a pointer to the internal data storage of type \ref QCPDataMap. You may use it to
+  directly manipulate the data, which may be more convenient and faster than using the regular \ref
+  setData or \ref addData methods, in certain situations.
+  
+  The map is only used while the data storage is \ref dsMap (the default). With \ref dsVector it
+  stays empty and the data is in \ref vectorData instead, see \ref setDataStorage.
+  
+  The graph notices changes made through this pointer by the number of points and the first and
+  last key, and then rebuilds its cached data ranges and hit test points. Only after changing keys
+  or values of points in place without affecting those, call \ref dataChanged.
+*/
+
+/*! \fn QCPDataVector *QCPGraph::vectorData() const
+  
+  Returns a pointer to the internal data storage of type \ref QCPDataVector. It holds the graph's
+  data while the data storage is \ref dsVector, and is empty otherwise. See \ref setDataStorage.
+  
+  Changes made through this pointer are noticed like the ones through \ref data.
+*/
+
+/* end of documentation of inline functions */
+
+/*!
+  Constructs a graph which uses \a keyAxis as its key axis ("x") and \a valueAxis as its value
+  axis ("y"). \a keyAxis and \a valueAxis must reside in the same QCustomPlot instance and not have
+  the same orientation. If either of these restrictions is violated, a corresponding message is
+  printed to the debug output (qDebug), the construction is not aborted, though.
+  
+  The constructed QCPGraph can be added to the plot with QCustomPlot::addPlottable, QCustomPlot
+  then takes ownership of the graph.
+  
+  To directly create a graph inside a plot, you can also use the simpler QCustomPlot::addGraph function.
+*/
+QCPGraph::QCPGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) :
+  QCPAbstractPlottable(keyAxis, valueAxis)
+{
+  mData = new QCPDataMap;
+  mDataVector = new QCPDataVector;
+  mDataStorage = dsMap;
+  mHasPreparedData = false;
+  mHitColumnOrigin = 0;
+  mSignatureCount = 0;
+  mSignatureFirstKey = 0;
+  mSignatureLastKey = 0;
+  
+  setPen(QPen(Qt::blue, 0));
+  setErrorPen(QPen(Qt::black));
+  setBrush(Qt::NoBrush);
+  setSelectedPen(QPen(QColor(80, 80, 255), 2.5));
+  setSelectedBrush(Qt::NoBrush);
+  
+  setLineStyle(lsLine);
+  setErrorType(etNone);
+  setErrorBarSize(6);
+  setErrorBarSkipSymbol(true);
+  setChannelFillGraph(0);
+  setAdaptiveSampling(true);
+}
+
+QCPGraph::~QCPGraph()
+{
+  delete mData;
+  delete mDataVector;
+}
+
+/*!
+  Replaces the current data with the provided \a data.
+  
+  If \a copy is set to true, data points in \a data will only be copied. if false, the graph
+  takes ownership of the passed data and replaces the internal data pointer with it. This is
+  significantly faster than copying for large datasets.
+  
+  With the \ref dsVector data storage, the points are always copied into the \ref QCPDataVector,
+  and \a data is deleted afterwards if \a copy is false.
+  
+  Alternatively, you can also access and modify the graph's data via the \ref data method, which
+  returns a pointer to the internal \ref QCPDataMap.
+*/
+void QCPGraph::setData(QCPDataMap *data, bool copy)
+{
+  invalidateCachedRanges();
+  if (mDataStorage == dsVector)
+  {
+    mDataVector->fromMap(*data);
+    if (!copy)
+      delete data;
+    return;
+  }
+  if (copy)
+  {
+    *mData = *data;
+  } else
+  {
+    delete mData;
+    mData = data;
+  }
+}
+
+/*! \overload
+  
+  Replaces the current data with the provided points in \a key and \a value pairs. The provided
+  vectors should have equal length. Else, the number of added points will be the size of the
+  smallest vector.
+*/
+void QCPGraph::setData(const QVector<double> &key, const QVector<double> &value)
+{
+  invalidateCachedRanges();
+  if (mDataStorage == dsVector)
+  {
+    mDataVector->set(key, value);
+    return;
+  }
+  mData->clear();
+  int n = key.size();
+  n = qMin(n, value.size());
+  QCPData newData;
+  for (int i=0; i<n; ++i)
+  {
+    newData.key = key[i];
+    newData.value = value[i];
+    mData->insertMulti(newData.key, newData);
   }
 }
 
@@ -14574,7 +16224,7 @@ void QCPGraph::setData(const QVector<double> &key, const QVector<double> &value)
 */
 void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &valueError)
 {
-  mData->clear();
+  clearData();
   int n = key.size();
   n = qMin(n, value.size());
   n = qMin(n, valueError.size());
@@ -14585,7 +16235,10 @@ void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<doubl
     newData.value = value[i];
     newData.valueErrorMinus = valueError[i];
     newData.valueErrorPlus = valueError[i];
-    mData->insertMulti(key[i], newData);
+    if (mDataStorage == dsVector)
+      mDataVector->add(newData);
+    else
+      mData->insertMulti(key[i], newData);
   }
 }
 
@@ -14600,7 +16253,7 @@ void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<doubl
 */
 void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &valueErrorMinus, const QVector<double> &valueErrorPlus)
 {
-  mData->clear();
+  clearData();
   int n = key.size();
   n = qMin(n, value.size());
   n = qMin(n, valueErrorMinus.size());
@@ -14612,7 +16265,10 @@ void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<doubl
     newData.value = value[i];
     newData.valueErrorMinus = valueErrorMinus[i];
     newData.valueErrorPlus = valueErrorPlus[i];
-    mData->insertMulti(key[i], newData);
+    if (mDataStorage == dsVector)
+      mDataVector->add(newData);
+    else
+      mData->insertMulti(key[i], newData);
   }
 }
 
@@ -14627,7 +16283,7 @@ void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<doubl
 */
 void QCPGraph::setDataKeyError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &keyError)
 {
-  mData->clear();
+  clearData();
   int n = key.size();
   n = qMin(n, value.size());
   n = qMin(n, keyError.size());
@@ -14638,7 +16294,10 @@ void QCPGraph::setDataKeyError(const QVector<double> &key, const QVector<double>
     newData.value = value[i];
     newData.keyErrorMinus = keyError[i];
     newData.keyErrorPlus = keyError[i];
-    mData->insertMulti(key[i], newData);
+    if (mDataStorage == dsVector)
+      mDataVector->add(newData);
+    else
+      mData->insertMulti(key[i], newData);
   }
 }
 
@@ -14653,7 +16312,7 @@ void QCPGraph::setDataKeyError(const QVector<double> &key, const QVector<double>
 */
 void QCPGraph::setDataKeyError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &keyErrorMinus, const QVector<double> &keyErrorPlus)
 {
-  mData->clear();
+  clearData();
   int n = key.size();
   n = qMin(n, value.size());
   n = qMin(n, keyErrorMinus.size());
@@ -14665,7 +16324,10 @@ void QCPGraph::setDataKeyError(const QVector<double> &key, const QVector<double>
     newData.value = value[i];
     newData.keyErrorMinus = keyErrorMinus[i];
     newData.keyErrorPlus = keyErrorPlus[i];
-    mData->insertMulti(key[i], newData);
+    if (mDataStorage == dsVector)
+      mDataVector->add(newData);
+    else
+      mData->insertMulti(key[i], newData);
   }
 }
 
@@ -14680,7 +16342,7 @@ void QCPGraph::setDataKeyError(const QVector<double> &key, const QVector<double>
 */
 void QCPGraph::setDataBothError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &keyError, const QVector<double> &valueError)
 {
-  mData->clear();
+  clearData();
   int n = key.size();
   n = qMin(n, value.size());
   n = qMin(n, valueError.size());
@@ -14694,7 +16356,10 @@ void QCPGraph::setDataBothError(const QVector<double> &key, const QVector<double
     newData.keyErrorPlus = keyError[i];
     newData.valueErrorMinus = valueError[i];
     newData.valueErrorPlus = valueError[i];
-    mData->insertMulti(key[i], newData);
+    if (mDataStorage == dsVector)
+      mDataVector->add(newData);
+    else
+      mData->insertMulti(key[i], newData);
   }
 }
 
@@ -14709,7 +16374,7 @@ void QCPGraph::setDataBothError(const QVector<double> &key, const QVector<double
 */
 void QCPGraph::setDataBothError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &keyErrorMinus, const QVector<double> &keyErrorPlus, const QVector<double> &valueErrorMinus, const QVector<double> &valueErrorPlus)
 {
-  mData->clear();
+  clearData();
   int n = key.size();
   n = qMin(n, value.size());
   n = qMin(n, valueErrorMinus.size());
@@ -14725,7 +16390,10 @@ void QCPGraph::setDataBothError(const QVector<double> &key, const QVector<double
     newData.keyErrorPlus = keyErrorPlus[i];
     newData.valueErrorMinus = valueErrorMinus[i];
     newData.valueErrorPlus = valueErrorPlus[i];
-    mData->insertMulti(key[i], newData);
+    if (mDataStorage == dsVector)
+      mDataVector->add(newData);
+    else
+      mData->insertMulti(key[i], newData);
   }
 }
 
@@ -14863,6 +16531,59 @@ void QCPGraph::setAdaptiveSampling(bool enabled)
   mAdaptiveSampling = enabled;
 }
 
+/*!
+  Sets the container the graph keeps its data in. The present data points are moved to the new
+  container.
+  
+  \ref dsMap (the default) keeps the data in the \ref QCPDataMap returned by \ref data. \ref
+  dsVector keeps it in two contiguous arrays sorted by key (\ref QCPDataVector, returned by \ref
+  vectorData). The vector needs a fraction of the memory, loads a complete data set with \ref
+  setData(const QVector<double>&, const QVector<double>&) without any per-point allocation, and is
+  faster to replot. It is the better choice for large data sets that arrive in key order; inserting
+  points in the middle of a large vector is slower than in the map.
+  
+  All \ref setData, \ref addData and \ref removeData functions work with both storage modes. Only
+  code accessing the containers directly needs to use the one matching the mode.
+  
+  Switching to \ref dsMap removes a capacity set with \ref setDataCapacity.
+*/
+void QCPGraph::setDataStorage(DataStorage storage)
+{
+  if (mDataStorage == storage)
+    return;
+  if (storage == dsVector)
+  {
+    mDataVector->fromMap(*mData);
+    mData->clear();
+  } else
+  {
+    *mData = mDataVector->toMap();
+    mDataVector->setCapacity(0);
+    mDataVector->clear();
+  }
+  mDataStorage = storage;
+}
+
+/*!
+  Limits the graph to the \a capacity data points with the largest keys, 0 (the default) means no
+  limit. This turns the graph into a rolling window for continuous recordings, e.g. the last 60
+  seconds of a 10 kHz signal with a capacity of 600000: every point added beyond the capacity
+  pushes out the oldest one.
+  
+  The limit is kept by the \ref QCPDataVector (see \ref QCPDataVector::setCapacity), so a
+  non-zero \a capacity switches the graph to the \ref dsVector storage. There, appending and
+  dropping points cost constant time per point and the memory of the graph stays fixed, while
+  adaptive sampling and the visible range lookup work on contiguous arrays as usual. Use \ref
+  appendData to stream into the window and move the key axis range along with the newest key.
+*/
+void QCPGraph::setDataCapacity(int capacity)
+{
+  if (capacity > 0)
+    setDataStorage(dsVector);
+  mDataVector->setCapacity(capacity);
+  invalidateCachedRanges();
+}
+
 /*!
   Adds the provided data points in \a dataMap to the current data.
   
@@ -14873,7 +16594,19 @@ void QCPGraph::setAdaptiveSampling(bool enabled)
 */
 void QCPGraph::addData(const QCPDataMap &dataMap)
 {
-  mData->unite(dataMap);
+  checkDataSignature();
+  QCPDataMap::const_iterator it;
+  for (it = dataMap.constBegin(); it != dataMap.constEnd(); ++it)
+    addToCachedRanges(it.value());
+  if (mDataStorage == dsVector)
+  {
+    int expectedSize = mDataVector->size()+dataMap.size();
+    mDataVector->add(dataMap);
+    if (mDataVector->size() < expectedSize) // points were pushed out, see setDataCapacity
+      invalidateCachedRanges();
+  } else
+    mData->unite(dataMap);
+  storeDataSignature();
 }
 
 /*! \overload
@@ -14886,7 +16619,17 @@ void QCPGraph::addData(const QCPDataMap &dataMap)
 */
 void QCPGraph::addData(const QCPData &data)
 {
-  mData->insertMulti(data.key, data);
+  checkDataSignature();
+  addToCachedRanges(data);
+  if (mDataStorage == dsVector)
+  {
+    int expectedSize = mDataVector->size()+1;
+    mDataVector->add(data);
+    if (mDataVector->size() < expectedSize) // points were pushed out, see setDataCapacity
+      invalidateCachedRanges();
+  } else
+    addMapData(data);
+  storeDataSignature();
 }
 
 /*! \overload
@@ -14899,15 +16642,31 @@ void QCPGraph::addData(const QCPData &data)
 */
 void QCPGraph::addData(double key, double value)
 {
+  checkDataSignature();
+  addToCachedRanges(QCPData(key, value));
+  if (mDataStorage == dsVector)
+  {
+    int expectedSize = mDataVector->size()+1;
+    mDataVector->add(key, value);
+    if (mDataVector->size() < expectedSize) // points were pushed out, see setDataCapacity
+      invalidateCachedRanges();
+    storeDataSignature();
+    return;
+  }
   QCPData newData;
   newData.key = key;
   newData.value = value;
-  mData->insertMulti(newData.key, newData);
+  addMapData(newData);
+  storeDataSignature();
 }
 
 /*! \overload
   Adds the provided data points as \a key and \a value pairs to the current data.
   
+  Points whose keys continue behind the present data are appended without searching their
+  position, so adding data in key order costs the same per point regardless of how many points the
+  graph already holds. If the keys are known to be sorted, \ref appendData skips even the check.
+  
   Alternatively, you can also access and modify the graph's data via the \ref data method, which
   returns a pointer to the internal \ref QCPDataMap.
   
@@ -14915,14 +16674,69 @@ void QCPGraph::addData(double key, double value)
 */
 void QCPGraph::addData(const QVector<double> &keys, const QVector<double> &values)
 {
+  checkDataSignature();
   int n = qMin(keys.size(), values.size());
+  for (int i=0; i<n; ++i)
+    addToCachedRanges(QCPData(keys[i], values[i]));
+  if (mDataStorage == dsVector)
+  {
+    int expectedSize = mDataVector->size()+n;
+    mDataVector->add(keys, values);
+    if (mDataVector->size() < expectedSize) // points were pushed out, see setDataCapacity
+      invalidateCachedRanges();
+    storeDataSignature();
+    return;
+  }
   QCPData newData;
   for (int i=0; i<n; ++i)
   {
     newData.key = keys[i];
     newData.value = values[i];
-    mData->insertMulti(newData.key, newData);
+    addMapData(newData);
+  }
+  storeDataSignature();
+}
+
+/*!
+  Appends the provided data points as \a key and \a value pairs behind the current data. The
+  vectors should have equal length. Else, the number of appended points will be the size of the
+  smallest vector.
+  
+  This is the fastest way to stream measurements into a graph. \a keys must be sorted ascending,
+  which is not checked; only if the first key lies before the last present point, the points are
+  added like with \ref addData. With the \ref dsVector data storage the points are copied as one
+  block (see \ref QCPDataVector::appendSorted), with \ref dsMap each one is appended to the end of
+  the map without searching its position.
+  
+  \see addData, setDataStorage
+*/
+void QCPGraph::appendData(const QVector<double> &keys, const QVector<double> &values)
+{
+  appendData(keys.constData(), values.constData(), qMin(keys.size(), values.size()));
+}
+
+/*! \overload
+  
+  Appends \a count data points from the \a keys and \a values arrays, e.g. straight from an
+  acquisition buffer without copying them into vectors first.
+*/
+void QCPGraph::appendData(const double *keys, const double *values, int count)
+{
+  checkDataSignature();
+  for (int i=0; i<count; ++i)
+    addToCachedRanges(QCPData(keys[i], values[i]));
+  if (mDataStorage == dsVector)
+  {
+    int expectedSize = mDataVector->size()+qMax(0, count);
+    mDataVector->appendSorted(keys, values, count);
+    if (mDataVector->size() < expectedSize) // points were pushed out, see setDataCapacity
+      invalidateCachedRanges();
+    storeDataSignature();
+    return;
   }
+  for (int i=0; i<count; ++i)
+    addMapData(QCPData(keys[i], values[i]));
+  storeDataSignature();
 }
 
 /*!
@@ -14931,9 +16745,22 @@ void QCPGraph::addData(const QVector<double> &keys, const QVector<double> &value
 */
 void QCPGraph::removeDataBefore(double key)
 {
+  checkDataSignature();
+  if (mDataStorage == dsVector)
+  {
+    for (int i=0, end=mDataVector->lowerBoundIndex(key); i<end; ++i)
+      removeFromCachedRanges(mDataVector->at(i));
+    mDataVector->removeBefore(key);
+    storeDataSignature();
+    return;
+  }
   QCPDataMap::iterator it = mData->begin();
   while (it != mData->end() && it.key() < key)
+  {
+    removeFromCachedRanges(it.value());
     it = mData->erase(it);
+  }
+  storeDataSignature();
 }
 
 /*!
@@ -14942,10 +16769,23 @@ void QCPGraph::removeDataBefore(double key)
 */
 void QCPGraph::removeDataAfter(double key)
 {
+  checkDataSignature();
+  if (mDataStorage == dsVector)
+  {
+    for (int i=mDataVector->upperBoundIndex(key), end=mDataVector->size(); i<end; ++i)
+      removeFromCachedRanges(mDataVector->at(i));
+    mDataVector->removeAfter(key);
+    storeDataSignature();
+    return;
+  }
   if (mData->isEmpty()) return;
   QCPDataMap::iterator it = mData->upperBound(key);
   while (it != mData->end())
+  {
+    removeFromCachedRanges(it.value());
     it = mData->erase(it);
+  }
+  storeDataSignature();
 }
 
 /*!
@@ -14957,11 +16797,27 @@ void QCPGraph::removeDataAfter(double key)
 */
 void QCPGraph::removeData(double fromKey, double toKey)
 {
+  checkDataSignature();
+  if (mDataStorage == dsVector)
+  {
+    if (fromKey < toKey)
+    {
+      for (int i=mDataVector->upperBoundIndex(fromKey), end=mDataVector->upperBoundIndex(toKey); i<end; ++i)
+        removeFromCachedRanges(mDataVector->at(i));
+    }
+    mDataVector->remove(fromKey, toKey);
+    storeDataSignature();
+    return;
+  }
   if (fromKey >= toKey || mData->isEmpty()) return;
   QCPDataMap::iterator it = mData->upperBound(fromKey);
   QCPDataMap::iterator itEnd = mData->upperBound(toKey);
   while (it != itEnd)
+  {
+    removeFromCachedRanges(it.value());
     it = mData->erase(it);
+  }
+  storeDataSignature();
 }
 
 /*! \overload
@@ -14974,7 +16830,34 @@ void QCPGraph::removeData(double fromKey, double toKey)
 */
 void QCPGraph::removeData(double key)
 {
-  mData->remove(key);
+  checkDataSignature();
+  if (mDataStorage == dsVector)
+  {
+    for (int i=mDataVector->lowerBoundIndex(key), end=mDataVector->upperBoundIndex(key); i<end; ++i)
+      removeFromCachedRanges(mDataVector->at(i));
+    mDataVector->remove(key);
+  } else
+  {
+    foreach (const QCPData &data, mData->values(key))
+      removeFromCachedRanges(data);
+    mData->remove(key);
+  }
+  storeDataSignature();
+}
+
+/*!
+  Tells the graph that its data was changed directly through the pointer returned by \ref data or
+  \ref vectorData. The cached data ranges (used by \ref rescaleAxes and the like) and the hit test
+  points are discarded and rebuilt from the data when they are needed next.
+  
+  Calling this is optional in most cases: the graph notices direct changes by itself when they
+  change the number of points or the first or last key. It's only needed after points were
+  modified in place, e.g. new values for existing keys. Changes made with the graph's own methods
+  (\ref setData, \ref addData, \ref removeData etc.) never need it.
+*/
+void QCPGraph::dataChanged()
+{
+  invalidateCachedRanges();
 }
 
 /*!
@@ -14984,13 +16867,15 @@ void QCPGraph::removeData(double key)
 void QCPGraph::clearData()
 {
   mData->clear();
+  mDataVector->clear();
+  invalidateCachedRanges();
 }
 
 /* inherits documentation from base class */
 double QCPGraph::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const
 {
   Q_UNUSED(details)
-  if ((onlySelectable && !mSelectable) || mData->isEmpty())
+  if ((onlySelectable && !mSelectable) || !hasData())
     return -1;
   if (!mKeyAxis || !mValueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return -1; }
   
@@ -15024,7 +16909,7 @@ void QCPGraph::rescaleKeyAxis(bool onlyEnlarge, bool includeErrorBars) const
 {
   // this code is a copy of QCPAbstractPlottable::rescaleKeyAxis with the only change
   // that getKeyRange is passed the includeErrorBars value.
-  if (mData->isEmpty()) return;
+  if (!hasData()) return;
   
   QCPAxis *keyAxis = mKeyAxis.data();
   if (!keyAxis) { qDebug() << Q_FUNC_INFO << "invalid key axis"; return; }
@@ -15060,7 +16945,7 @@ void QCPGraph::rescaleValueAxis(bool onlyEnlarge, bool includeErrorBars) const
 {
   // this code is a copy of QCPAbstractPlottable::rescaleValueAxis with the only change
   // is that getValueRange is passed the includeErrorBars value.
-  if (mData->isEmpty()) return;
+  if (!hasData()) return;
   
   QCPAxis *valueAxis = mValueAxis.data();
   if (!valueAxis) { qDebug() << Q_FUNC_INFO << "invalid value axis"; return; }
@@ -15089,7 +16974,7 @@ void QCPGraph::rescaleValueAxis(bool onlyEnlarge, bool includeErrorBars) const
 void QCPGraph::draw(QCPPainter *painter)
 {
   if (!mKeyAxis || !mValueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
-  if (mKeyAxis.data()->range().size() <= 0 || mData->isEmpty()) return;
+  if (mKeyAxis.data()->range().size() <= 0 || !hasData()) return;
   if (mLineStyle == lsNone && mScatterStyle.isNone()) return;
   
   // allocate line and (if necessary) point vectors:
@@ -15098,13 +16983,22 @@ void QCPGraph::draw(QCPPainter *painter)
   if (!mScatterStyle.isNone())
     scatterData = new QVector<QCPData>;
   
-  // fill vectors with data appropriate to plot style:
-  getPlotData(lineData, scatterData);
+  // fill vectors with data appropriate to plot style, unless the plot already did (see preparePlotData):
+  if (mHasPreparedData)
+  {
+    lineData->swap(mPreparedLineData);
+    if (scatterData)
+      scatterData->swap(mPreparedScatterData);
+    mPreparedScatterData.clear();
+    mHasPreparedData = false;
+  } else
+    getPlotData(lineData, scatterData);
   
   // check data validity if flag set:
 #ifdef QCUSTOMPLOT_CHECK_DATA
+  QCPDataMap checkedData = (mDataStorage == dsVector ? mDataVector->toMap() : *mData);
   QCPDataMap::const_iterator it;
-  for (it = mData->constBegin(); it != mData->constEnd(); ++it)
+  for (it = checkedData.constBegin(); it != checkedData.constEnd(); ++it)
   {
     if (QCP::isInvalidData(it.value().key, it.value().value) ||
         QCP::isInvalidData(it.value().keyErrorPlus, it.value().keyErrorMinus) ||
@@ -15126,6 +17020,15 @@ void QCPGraph::draw(QCPPainter *painter)
   if (scatterData)
     drawScatterPlot(painter, scatterData);
   
+  // keep the line for hit testing, clicks refer to what was drawn last (see pointDistance):
+  if (mLineStyle != lsNone)
+  {
+    mHitPoints.swap(*lineData);
+    mHitSignature = hitTestSignature();
+    mHitColumnStart.clear();
+    mHitColumnSegments.clear();
+  }
+  
   // free allocated line and point vectors:
   delete lineData;
   if (scatterData)
@@ -15198,6 +17101,28 @@ void QCPGraph::getPlotData(QVector<QPointF> *lineData, QVector<QCPData> *scatter
   }
 }
 
+/*! \internal
+  
+  Computes the line and scatter data of the next \ref draw call ahead of time, exactly as \ref
+  draw would with \ref getPlotData, and keeps it until then.
+  
+  This is called by QCustomPlot for all graphs of a replot at once, possibly from threads of the
+  global QThreadPool (see \ref QCP::phParallelPreparation). It must therefore only read the data
+  of this graph and the state of its axes, which doesn't change while the replot runs.
+*/
+void QCPGraph::preparePlotData()
+{
+  mPreparedLineData.clear();
+  mPreparedScatterData.clear();
+  mHasPreparedData = false;
+  if (!mKeyAxis || !mValueAxis) return;
+  if (mKeyAxis.data()->range().size() <= 0 || !hasData()) return;
+  if (mLineStyle == lsNone && mScatterStyle.isNone()) return;
+  
+  getPlotData(&mPreparedLineData, mScatterStyle.isNone() ? 0 : &mPreparedScatterData);
+  mHasPreparedData = true;
+}
+
 /*! \internal
   
   If line style is \ref lsNone and the scatter style's shape is not \ref QCPScatterStyle::ssNone,
@@ -15237,22 +17162,14 @@ void QCPGraph::getLinePlotData(QVector<QPointF> *linePixelData, QVector<QCPData>
   linePixelData->reserve(lineData.size()+2); // added 2 to reserve memory for lower/upper fill base points that might be needed for fill
   linePixelData->resize(lineData.size());
   
-  // transform lineData points to pixels:
-  if (keyAxis->orientation() == Qt::Vertical)
-  {
-    for (int i=0; i<lineData.size(); ++i)
-    {
-      (*linePixelData)[i].setX(valueAxis->coordToPixel(lineData.at(i).value));
-      (*linePixelData)[i].setY(keyAxis->coordToPixel(lineData.at(i).key));
-    }
-  } else // key axis is horizontal
-  {
-    for (int i=0; i<lineData.size(); ++i)
-    {
-      (*linePixelData)[i].setX(keyAxis->coordToPixel(lineData.at(i).key));
-      (*linePixelData)[i].setY(valueAxis->coordToPixel(lineData.at(i).value));
-    }
-  }
+  // transform lineData points to pixels, straight into the x and y coordinates of linePixelData:
+  if (lineData.isEmpty())
+    return;
+  const int dataStride = sizeof(QCPData)/sizeof(double);
+  qreal *points = &linePixelData->data()->rx();
+  const int keyOffset = keyAxis->orientation() == Qt::Vertical ? 1 : 0;
+  keyAxis->coordsToPixels(&lineData.constData()->key, dataStride, points+keyOffset, 2, lineData.size());
+  valueAxis->coordsToPixels(&lineData.constData()->value, dataStride, points+1-keyOffset, 2, lineData.size());
 }
 
 /*!
@@ -15275,33 +17192,35 @@ void QCPGraph::getStepLeftPlotData(QVector<QPointF> *linePixelData, QVector<QCPD
   
   QVector<QCPData> lineData;
   getPreparedData(&lineData, scatterData);
+  QVector<qreal> keyPixels, valuePixels;
+  dataToPixels(lineData, &keyPixels, &valuePixels);
   linePixelData->reserve(lineData.size()*2+2); // added 2 to reserve memory for lower/upper fill base points that might be needed for fill
   linePixelData->resize(lineData.size()*2);
   
   // calculate steps from lineData and transform to pixel coordinates:
   if (keyAxis->orientation() == Qt::Vertical)
   {
-    double lastValue = valueAxis->coordToPixel(lineData.first().value);
+    double lastValue = valuePixels.first();
     double key;
     for (int i=0; i<lineData.size(); ++i)
     {
-      key = keyAxis->coordToPixel(lineData.at(i).key);
+      key = keyPixels.at(i);
       (*linePixelData)[i*2+0].setX(lastValue);
       (*linePixelData)[i*2+0].setY(key);
-      lastValue = valueAxis->coordToPixel(lineData.at(i).value);
+      lastValue = valuePixels.at(i);
       (*linePixelData)[i*2+1].setX(lastValue);
       (*linePixelData)[i*2+1].setY(key);
     }
   } else // key axis is horizontal
   {
-    double lastValue = valueAxis->coordToPixel(lineData.first().value);
+    double lastValue = valuePixels.first();
     double key;
     for (int i=0; i<lineData.size(); ++i)
     {
-      key = keyAxis->coordToPixel(lineData.at(i).key);
+      key = keyPixels.at(i);
       (*linePixelData)[i*2+0].setX(key);
       (*linePixelData)[i*2+0].setY(lastValue);
-      lastValue = valueAxis->coordToPixel(lineData.at(i).value);
+      lastValue = valuePixels.at(i);
       (*linePixelData)[i*2+1].setX(key);
       (*linePixelData)[i*2+1].setY(lastValue);
     }
@@ -15328,33 +17247,35 @@ void QCPGraph::getStepRightPlotData(QVector<QPointF> *linePixelData, QVector<QCP
   
   QVector<QCPData> lineData;
   getPreparedData(&lineData, scatterData);
+  QVector<qreal> keyPixels, valuePixels;
+  dataToPixels(lineData, &keyPixels, &valuePixels);
   linePixelData->reserve(lineData.size()*2+2); // added 2 to reserve memory for lower/upper fill base points that might be needed for fill
   linePixelData->resize(lineData.size()*2);
   
   // calculate steps from lineData and transform to pixel coordinates:
   if (keyAxis->orientation() == Qt::Vertical)
   {
-    double lastKey = keyAxis->coordToPixel(lineData.first().key);
+    double lastKey = keyPixels.first();
     double value;
     for (int i=0; i<lineData.size(); ++i)
     {
-      value = valueAxis->coordToPixel(lineData.at(i).value);
+      value = valuePixels.at(i);
       (*linePixelData)[i*2+0].setX(value);
       (*linePixelData)[i*2+0].setY(lastKey);
-      lastKey = keyAxis->coordToPixel(lineData.at(i).key);
+      lastKey = keyPixels.at(i);
       (*linePixelData)[i*2+1].setX(value);
       (*linePixelData)[i*2+1].setY(lastKey);
     }
   } else // key axis is horizontal
   {
-    double lastKey = keyAxis->coordToPixel(lineData.first().key);
+    double lastKey = keyPixels.first();
     double value;
     for (int i=0; i<lineData.size(); ++i)
     {
-      value = valueAxis->coordToPixel(lineData.at(i).value);
+      value = valuePixels.at(i);
       (*linePixelData)[i*2+0].setX(lastKey);
       (*linePixelData)[i*2+0].setY(value);
-      lastKey = keyAxis->coordToPixel(lineData.at(i).key);
+      lastKey = keyPixels.at(i);
       (*linePixelData)[i*2+1].setX(lastKey);
       (*linePixelData)[i*2+1].setY(value);
     }
@@ -15381,23 +17302,25 @@ void QCPGraph::getStepCenterPlotData(QVector<QPointF> *linePixelData, QVector<QC
   
   QVector<QCPData> lineData;
   getPreparedData(&lineData, scatterData);
+  QVector<qreal> keyPixels, valuePixels;
+  dataToPixels(lineData, &keyPixels, &valuePixels);
   linePixelData->reserve(lineData.size()*2+2); // added 2 to reserve memory for lower/upper fill base points that might be needed for fill
   linePixelData->resize(lineData.size()*2);
   // calculate steps from lineData and transform to pixel coordinates:
   if (keyAxis->orientation() == Qt::Vertical)
   {
-    double lastKey = keyAxis->coordToPixel(lineData.first().key);
-    double lastValue = valueAxis->coordToPixel(lineData.first().value);
+    double lastKey = keyPixels.first();
+    double lastValue = valuePixels.first();
     double key;
     (*linePixelData)[0].setX(lastValue);
     (*linePixelData)[0].setY(lastKey);
     for (int i=1; i<lineData.size(); ++i)
     {
-      key = (keyAxis->coordToPixel(lineData.at(i).key)+lastKey)*0.5;
+      key = (keyPixels.at(i)+lastKey)*0.5;
       (*linePixelData)[i*2-1].setX(lastValue);
       (*linePixelData)[i*2-1].setY(key);
-      lastValue = valueAxis->coordToPixel(lineData.at(i).value);
-      lastKey = keyAxis->coordToPixel(lineData.at(i).key);
+      lastValue = valuePixels.at(i);
+      lastKey = keyPixels.at(i);
       (*linePixelData)[i*2+0].setX(lastValue);
       (*linePixelData)[i*2+0].setY(key);
     }
@@ -15405,18 +17328,18 @@ void QCPGraph::getStepCenterPlotData(QVector<QPointF> *linePixelData, QVector<QC
     (*linePixelData)[lineData.size()*2-1].setY(lastKey);
   } else // key axis is horizontal
   {
-    double lastKey = keyAxis->coordToPixel(lineData.first().key);
-    double lastValue = valueAxis->coordToPixel(lineData.first().value);
+    double lastKey = keyPixels.first();
+    double lastValue = valuePixels.first();
     double key;
     (*linePixelData)[0].setX(lastKey);
     (*linePixelData)[0].setY(lastValue);
     for (int i=1; i<lineData.size(); ++i)
     {
-      key = (keyAxis->coordToPixel(lineData.at(i).key)+lastKey)*0.5;
+      key = (keyPixels.at(i)+lastKey)*0.5;
       (*linePixelData)[i*2-1].setX(key);
       (*linePixelData)[i*2-1].setY(lastValue);
-      lastValue = valueAxis->coordToPixel(lineData.at(i).value);
-      lastKey = keyAxis->coordToPixel(lineData.at(i).key);
+      lastValue = valuePixels.at(i);
+      lastKey = keyPixels.at(i);
       (*linePixelData)[i*2+0].setX(key);
       (*linePixelData)[i*2+0].setY(lastValue);
     }
@@ -15446,6 +17369,8 @@ void QCPGraph::getImpulsePlotData(QVector<QPointF> *linePixelData, QVector<QCPDa
   
   QVector<QCPData> lineData;
   getPreparedData(&lineData, scatterData);
+  QVector<qreal> keyPixels, valuePixels;
+  dataToPixels(lineData, &keyPixels, &valuePixels);
   linePixelData->resize(lineData.size()*2); // no need to reserve 2 extra points because impulse plot has no fill
   
   // transform lineData points to pixels:
@@ -15455,10 +17380,10 @@ void QCPGraph::getImpulsePlotData(QVector<QPointF> *linePixelData, QVector<QCPDa
     double key;
     for (int i=0; i<lineData.size(); ++i)
     {
-      key = keyAxis->coordToPixel(lineData.at(i).key);
+      key = keyPixels.at(i);
       (*linePixelData)[i*2+0].setX(zeroPointX);
       (*linePixelData)[i*2+0].setY(key);
-      (*linePixelData)[i*2+1].setX(valueAxis->coordToPixel(lineData.at(i).value));
+      (*linePixelData)[i*2+1].setX(valuePixels.at(i));
       (*linePixelData)[i*2+1].setY(key);
     }
   } else // key axis is horizontal
@@ -15467,11 +17392,11 @@ void QCPGraph::getImpulsePlotData(QVector<QPointF> *linePixelData, QVector<QCPDa
     double key;
     for (int i=0; i<lineData.size(); ++i)
     {
-      key = keyAxis->coordToPixel(lineData.at(i).key);
+      key = keyPixels.at(i);
       (*linePixelData)[i*2+0].setX(key);
       (*linePixelData)[i*2+0].setY(zeroPointY);
       (*linePixelData)[i*2+1].setX(key);
-      (*linePixelData)[i*2+1].setY(valueAxis->coordToPixel(lineData.at(i).value));
+      (*linePixelData)[i*2+1].setY(valuePixels.at(i));
     }
   }
 }
@@ -15575,34 +17500,120 @@ void QCPGraph::drawLinePlot(QCPPainter *painter, QVector<QPointF> *lineData) con
     painter->setPen(mainPen());
     painter->setBrush(Qt::NoBrush);
     
-    /* Draws polyline in batches, currently not used:
-    int p = 0;
-    while (p < lineData->size())
-    {
-      int batch = qMin(25, lineData->size()-p);
-      if (p != 0)
-      {
-        ++batch;
-        --p; // to draw the connection lines between two batches
-      }
-      painter->drawPolyline(lineData->constData()+p, batch);
-      p += batch;
-    }
-    */
-    
     // if drawing solid line and not in PDF, use much faster line drawing instead of polyline:
-    if (mParentPlot->plottingHints().testFlag(QCP::phFastPolylines) &&
+    const bool fastLines = mParentPlot->plottingHints().testFlag(QCP::phFastPolylines) &&
         painter->pen().style() == Qt::SolidLine &&
         !painter->modes().testFlag(QCPPainter::pmVectorized)&&
-        !painter->modes().testFlag(QCPPainter::pmNoCaching))
+        !painter->modes().testFlag(QCPPainter::pmNoCaching);
+    if (painter->pen().style() == Qt::SolidLine)
     {
-      for (int i=1; i<lineData->size(); ++i)
-        painter->drawLine(lineData->at(i-1), lineData->at(i));
+      // clip to the axis rect, enlarged so the line caps and joins at the border stay outside:
+      const double margin = qMax(1.0, painter->pen().widthF())+2;
+      drawClippedPolyline(painter, lineData, QRectF(clipRect()).adjusted(-margin, -margin, margin, margin), fastLines);
+    } else // clipping and splitting would restart the dash pattern
+    {
+      painter->drawPolyline(QPolygonF(*lineData));
+    }
+  }
+}
+
+/*! \internal
+  
+  Draws the polyline through the points of \a lineData, restricted to the rect \a clip. Used by
+  \ref drawLinePlot for solid pens.
+  
+  Every segment is clipped to \a clip (see \ref clipSegment) before it is handed to the painter,
+  segments outside are dropped. So points far outside the axis rect, e.g. of a deeply zoomed-in
+  graph, cost no rasterization and don't send huge coordinates to the paint engine. The visible
+  parts are drawn as polylines of at most 512 points, which keeps the paint engine's working set
+  small for long lines.
+  
+  If \a separateLines is true, the segments are drawn with individual drawLine calls instead of
+  polylines (see \ref QCP::phFastPolylines).
+*/
+void QCPGraph::drawClippedPolyline(QCPPainter *painter, const QVector<QPointF> *lineData, const QRectF &clip, bool separateLines) const
+{
+  const int chunkSize = 512;
+  QVector<QPointF> chunk;
+  chunk.reserve(chunkSize);
+  for (int i=1; i<=lineData->size(); ++i) // the last iteration only draws what's left
+  {
+    bool visible = false;
+    QPointF start, end;
+    if (i < lineData->size())
+    {
+      start = lineData->at(i-1);
+      end = lineData->at(i);
+      visible = clipSegment(&start, &end, clip);
+    }
+    // draw the current polyline when the line leaves the clip rect, enters it again elsewhere, or the chunk is full:
+    if (!chunk.isEmpty() && (!visible || start != chunk.last() || chunk.size() >= chunkSize))
+    {
+      if (separateLines)
+      {
+        for (int k=1; k<chunk.size(); ++k)
+          painter->drawLine(chunk.at(k-1), chunk.at(k));
+      } else
+        painter->drawPolyline(chunk.constData(), chunk.size());
+      chunk.clear();
+    }
+    if (visible)
+    {
+      if (chunk.isEmpty())
+        chunk.append(start);
+      chunk.append(end);
+    }
+  }
+}
+
+/*! \internal
+  
+  Clips the line segment from \a start to \a end to the rect \a clip, by moving the end points
+  that lie outside onto the border of \a clip (Liang-Barsky algorithm). Returns false if no part
+  of the segment is inside \a clip, or if a coordinate is NaN or infinite.
+*/
+bool QCPGraph::clipSegment(QPointF *start, QPointF *end, const QRectF &clip)
+{
+  const double x0 = start->x();
+  const double y0 = start->y();
+  if (QCP::isInvalidData(x0, y0) || QCP::isInvalidData(end->x(), end->y()))
+    return false;
+  const double dx = end->x()-x0;
+  const double dy = end->y()-y0;
+  // parametrize the segment as (x0+t*dx, y0+t*dy) with t in [0, 1] and narrow t down at each border:
+  const double p[4] = {-dx, dx, -dy, dy};
+  const double q[4] = {x0-clip.left(), clip.right()-x0, y0-clip.top(), clip.bottom()-y0};
+  double tStart = 0;
+  double tEnd = 1;
+  for (int k=0; k<4; ++k)
+  {
+    if (p[k] == 0) // parallel to this border
+    {
+      if (q[k] < 0)
+        return false;
     } else
     {
-      painter->drawPolyline(QPolygonF(*lineData));
+      const double t = q[k]/p[k];
+      if (p[k] < 0) // entering through this border
+      {
+        if (t > tEnd)
+          return false;
+        if (t > tStart)
+          tStart = t;
+      } else // leaving through this border
+      {
+        if (t < tStart)
+          return false;
+        if (t < tEnd)
+          tEnd = t;
+      }
     }
   }
+  if (tEnd < 1)
+    *end = QPointF(x0+tEnd*dx, y0+tEnd*dy);
+  if (tStart > 0)
+    *start = QPointF(x0+tStart*dx, y0+tStart*dy);
+  return true;
 }
 
 /*! \internal
@@ -15639,14 +17650,28 @@ void QCPGraph::drawImpulsePlot(QCPPainter *painter, QVector<QPointF> *lineData)
   This method is used by the various "get(...)PlotData" methods to get the basic working set of data.
 */
 void QCPGraph::getPreparedData(QVector<QCPData> *lineData, QVector<QCPData> *scatterData) const
+{
+  if (mDataStorage == dsVector)
+    getPreparedData(mDataVector, lineData, scatterData);
+  else
+    getPreparedData(mData, lineData, scatterData);
+}
+
+/*! \internal
+  
+  Implementation of \ref getPreparedData for both data storage modes, \a data is the graph's
+  \ref QCPDataMap or its \ref QCPDataVector.
+*/
+template <class DataContainer>
+void QCPGraph::getPreparedData(const DataContainer *data, QVector<QCPData> *lineData, QVector<QCPData> *scatterData) const
 {
   QCPAxis *keyAxis = mKeyAxis.data();
   QCPAxis *valueAxis = mValueAxis.data();
   if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
   // get visible data range:
-  QCPDataMap::const_iterator lower, upper; // note that upper is the actual upper point, and not 1 step after the upper point
-  getVisibleDataBounds(lower, upper);
-  if (lower == mData->constEnd() || upper == mData->constEnd())
+  typename DataContainer::const_iterator lower, upper; // note that upper is the actual upper point, and not 1 step after the upper point
+  getVisibleDataBounds(data, lower, upper);
+  if (lower == data->constEnd() || upper == data->constEnd())
     return;
   
   // count points in visible range, taking into account that we only need to count to the limit maxCount if using adaptive sampling:
@@ -15661,74 +17686,19 @@ void QCPGraph::getPreparedData(QVector<QCPData> *lineData, QVector<QCPData> *sca
   if (mAdaptiveSampling && dataCount >= maxCount) // use adaptive sampling only if there are at least two points per pixel on average
   {
     if (lineData)
-    {
-      QCPDataMap::const_iterator it = lower;
-      QCPDataMap::const_iterator upperEnd = upper+1;
-      double minValue = it.value().value;
-      double maxValue = it.value().value;
-      QCPDataMap::const_iterator currentIntervalFirstPoint = it;
-      int reversedFactor = keyAxis->rangeReversed() ? -1 : 1; // is used to calculate keyEpsilon pixel into the correct direction
-      int reversedRound = keyAxis->rangeReversed() ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
-      double currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(lower.key())+reversedRound));
-      double lastIntervalEndKey = currentIntervalStartKey;
-      double keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor)); // interval of one pixel on screen when mapped to plot key coordinates
-      bool keyEpsilonVariable = keyAxis->scaleType() == QCPAxis::stLogarithmic; // indicates whether keyEpsilon needs to be updated after every interval (for log axes)
-      int intervalDataCount = 1;
-      ++it; // advance iterator to second data point because adaptive sampling works in 1 point retrospect
-      while (it != upperEnd)
-      {
-        if (it.key() < currentIntervalStartKey+keyEpsilon) // data point is still within same pixel, so skip it and expand value span of this cluster if necessary
-        {
-          if (it.value().value < minValue)
-            minValue = it.value().value;
-          else if (it.value().value > maxValue)
-            maxValue = it.value().value;
-          ++intervalDataCount;
-        } else // new pixel interval started
-        {
-          if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
-          {
-            if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point is further away, so first point of this cluster must be at a real data point
-              lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint.value().value));
-            lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
-            lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
-            if (it.key() > currentIntervalStartKey+keyEpsilon*2) // new pixel started further away from previous cluster, so make sure the last point of the cluster is at a real data point
-              lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.8, (it-1).value().value));
-          } else
-            lineData->append(QCPData(currentIntervalFirstPoint.key(), currentIntervalFirstPoint.value().value));
-          lastIntervalEndKey = (it-1).value().key;
-          minValue = it.value().value;
-          maxValue = it.value().value;
-          currentIntervalFirstPoint = it;
-          currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(it.key())+reversedRound));
-          if (keyEpsilonVariable)
-            keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor));
-          intervalDataCount = 1;
-        }
-        ++it;
-      }
-      // handle last interval:
-      if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
-      {
-        if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point wasn't a cluster, so first point of this cluster must be at a real data point
-          lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint.value().value));
-        lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
-        lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
-      } else
-        lineData->append(QCPData(currentIntervalFirstPoint.key(), currentIntervalFirstPoint.value().value));
-    }
+      getAdaptiveLineData(data, lower, upper, lineData);
     
     if (scatterData)
     {
       double valueMaxRange = valueAxis->range().upper;
       double valueMinRange = valueAxis->range().lower;
-      QCPDataMap::const_iterator it = lower;
-      QCPDataMap::const_iterator upperEnd = upper+1;
+      typename DataContainer::const_iterator it = lower;
+      typename DataContainer::const_iterator upperEnd = upper+1;
       double minValue = it.value().value;
       double maxValue = it.value().value;
-      QCPDataMap::const_iterator minValueIt = it;
-      QCPDataMap::const_iterator maxValueIt = it;
-      QCPDataMap::const_iterator currentIntervalStart = it;
+      typename DataContainer::const_iterator minValueIt = it;
+      typename DataContainer::const_iterator maxValueIt = it;
+      typename DataContainer::const_iterator currentIntervalStart = it;
       int reversedFactor = keyAxis->rangeReversed() ? -1 : 1; // is used to calculate keyEpsilon pixel into the correct direction
       int reversedRound = keyAxis->rangeReversed() ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
       double currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(lower.key())+reversedRound));
@@ -15757,7 +17727,7 @@ void QCPGraph::getPreparedData(QVector<QCPData> *lineData, QVector<QCPData> *sca
             // determine value pixel span and add as many points in interval to maintain certain vertical data density (this is specific to scatter plot):
             double valuePixelSpan = qAbs(valueAxis->coordToPixel(minValue)-valueAxis->coordToPixel(maxValue));
             int dataModulo = qMax(1, qRound(intervalDataCount/(valuePixelSpan/4.0))); // approximately every 4 value pixels one data point on average
-            QCPDataMap::const_iterator intervalIt = currentIntervalStart;
+            typename DataContainer::const_iterator intervalIt = currentIntervalStart;
             int c = 0;
             while (intervalIt != it)
             {
@@ -15784,7 +17754,7 @@ void QCPGraph::getPreparedData(QVector<QCPData> *lineData, QVector<QCPData> *sca
         // determine value pixel span and add as many points in interval to maintain certain vertical data density (this is specific to scatter plot):
         double valuePixelSpan = qAbs(valueAxis->coordToPixel(minValue)-valueAxis->coordToPixel(maxValue));
         int dataModulo = qMax(1, qRound(intervalDataCount/(valuePixelSpan/4.0))); // approximately every 4 value pixels one data point on average
-        QCPDataMap::const_iterator intervalIt = currentIntervalStart;
+        typename DataContainer::const_iterator intervalIt = currentIntervalStart;
         int c = 0;
         while (intervalIt != it)
         {
@@ -15805,8 +17775,8 @@ void QCPGraph::getPreparedData(QVector<QCPData> *lineData, QVector<QCPData> *sca
       dataVector = scatterData;
     if (dataVector)
     {
-      QCPDataMap::const_iterator it = lower;
-      QCPDataMap::const_iterator upperEnd = upper+1;
+      typename DataContainer::const_iterator it = lower;
+      typename DataContainer::const_iterator upperEnd = upper+1;
       dataVector->reserve(dataCount+2); // +2 for possible fill end points
       while (it != upperEnd)
       {
@@ -15819,6 +17789,126 @@ void QCPGraph::getPreparedData(QVector<QCPData> *lineData, QVector<QCPData> *sca
   }
 }
 
+/*! \internal
+  
+  Called by \ref getPreparedData when adaptive sampling is in effect. Consolidates the data points
+  from \a lower to \a upper (including them) that fall into the same key pixel to a cluster of up to
+  four points spanning their value range, and appends the result to \a lineData.
+  
+  This generic version walks every point of \a data, the graph's \ref QCPDataMap. The overload for
+  the \ref QCPDataVector finds the same clusters per pixel without visiting the points.
+*/
+template <class DataContainer>
+void QCPGraph::getAdaptiveLineData(const DataContainer *data, const typename DataContainer::const_iterator &lower, const typename DataContainer::const_iterator &upper, QVector<QCPData> *lineData) const
+{
+  Q_UNUSED(data)
+  QCPAxis *keyAxis = mKeyAxis.data();
+  typename DataContainer::const_iterator it = lower;
+  typename DataContainer::const_iterator upperEnd = upper+1;
+  double minValue = it.value().value;
+  double maxValue = it.value().value;
+  typename DataContainer::const_iterator currentIntervalFirstPoint = it;
+  int reversedFactor = keyAxis->rangeReversed() ? -1 : 1; // is used to calculate keyEpsilon pixel into the correct direction
+  int reversedRound = keyAxis->rangeReversed() ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
+  double currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(lower.key())+reversedRound));
+  double lastIntervalEndKey = currentIntervalStartKey;
+  double keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor)); // interval of one pixel on screen when mapped to plot key coordinates
+  bool keyEpsilonVariable = keyAxis->scaleType() == QCPAxis::stLogarithmic; // indicates whether keyEpsilon needs to be updated after every interval (for log axes)
+  int intervalDataCount = 1;
+  ++it; // advance iterator to second data point because adaptive sampling works in 1 point retrospect
+  while (it != upperEnd)
+  {
+    if (it.key() < currentIntervalStartKey+keyEpsilon) // data point is still within same pixel, so skip it and expand value span of this cluster if necessary
+    {
+      if (it.value().value < minValue)
+        minValue = it.value().value;
+      else if (it.value().value > maxValue)
+        maxValue = it.value().value;
+      ++intervalDataCount;
+    } else // new pixel interval started
+    {
+      if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
+      {
+        if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point is further away, so first point of this cluster must be at a real data point
+          lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint.value().value));
+        lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
+        lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
+        if (it.key() > currentIntervalStartKey+keyEpsilon*2) // new pixel started further away from previous cluster, so make sure the last point of the cluster is at a real data point
+          lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.8, (it-1).value().value));
+      } else
+        lineData->append(QCPData(currentIntervalFirstPoint.key(), currentIntervalFirstPoint.value().value));
+      lastIntervalEndKey = (it-1).value().key;
+      minValue = it.value().value;
+      maxValue = it.value().value;
+      currentIntervalFirstPoint = it;
+      currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(it.key())+reversedRound));
+      if (keyEpsilonVariable)
+        keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor));
+      intervalDataCount = 1;
+    }
+    ++it;
+  }
+  // handle last interval:
+  if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
+  {
+    if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point wasn't a cluster, so first point of this cluster must be at a real data point
+      lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint.value().value));
+    lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
+    lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
+  } else
+    lineData->append(QCPData(currentIntervalFirstPoint.key(), currentIntervalFirstPoint.value().value));
+}
+
+/*! \internal \overload
+  
+  Produces the same clusters as the generic version, but per pixel instead of per point: the end of
+  each pixel interval is found by binary search in the keys and its value span is looked up in the
+  vector's min/max pyramid (\ref QCPDataVector::valueBounds). A replot therefore costs
+  O(pixels*log(n)), independent of how many points are visible.
+*/
+void QCPGraph::getAdaptiveLineData(const QCPDataVector *data, const QCPDataVector::const_iterator &lower, const QCPDataVector::const_iterator &upper, QVector<QCPData> *lineData) const
+{
+  QCPAxis *keyAxis = mKeyAxis.data();
+  const double *keys = data->keyData();
+  const double *values = data->valueData();
+  int begin = lower.index();
+  int end = upper.index()+1;
+  
+  int reversedFactor = keyAxis->rangeReversed() ? -1 : 1; // is used to calculate keyEpsilon pixel into the correct direction
+  int reversedRound = keyAxis->rangeReversed() ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
+  double currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(keys[begin])+reversedRound));
+  double lastIntervalEndKey = currentIntervalStartKey;
+  double keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor)); // interval of one pixel on screen when mapped to plot key coordinates
+  bool keyEpsilonVariable = keyAxis->scaleType() == QCPAxis::stLogarithmic; // indicates whether keyEpsilon needs to be updated after every interval (for log axes)
+  lineData->reserve(4*(int)qAbs(keyAxis->coordToPixel(keys[begin])-keyAxis->coordToPixel(keys[end-1]))+6); // up to four points per pixel, +2 for possible fill end points
+  int i = begin;
+  while (i < end)
+  {
+    // first point that lies in a later pixel than point i:
+    int next = std::lower_bound(keys+i+1, keys+end, currentIntervalStartKey+keyEpsilon)-keys;
+    if (next-i >= 2) // pixel has multiple data points, consolidate them to a cluster
+    {
+      double minValue, maxValue;
+      data->valueBounds(i, next, minValue, maxValue);
+      if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point is further away, so first point of this cluster must be at a real data point
+        lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.2, values[i]));
+      lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
+      lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
+      if (next < end && keys[next] > currentIntervalStartKey+keyEpsilon*2) // new pixel starts further away from this cluster, so make sure the last point of the cluster is at a real data point
+        lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.8, values[next-1]));
+    } else
+      lineData->append(QCPData(keys[i], values[i]));
+    lastIntervalEndKey = keys[next-1];
+    i = next;
+    if (i < end)
+    {
+      currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(keys[i])+reversedRound));
+      if (keyEpsilonVariable)
+        keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor));
+    }
+  }
+}
+
 /*!  \internal
   
   called by the scatter drawing function (\ref drawScatterPlot) to draw the error bars on one data
@@ -15934,22 +18024,35 @@ void QCPGraph::drawError(QCPPainter *painter, double x, double y, const QCPData
   just outside of the visible range.
   
   if the graph contains no data, both \a lower and \a upper point to constEnd.
+  
+  This overload works on the \ref QCPDataMap, regardless of the data storage mode.
 */
 void QCPGraph::getVisibleDataBounds(QCPDataMap::const_iterator &lower, QCPDataMap::const_iterator &upper) const
+{
+  getVisibleDataBounds(mData, lower, upper);
+}
+
+/*! \internal
+  
+  Implementation of \ref getVisibleDataBounds for both data storage modes, \a data is the graph's
+  \ref QCPDataMap or its \ref QCPDataVector. Both containers find the bounds by binary search.
+*/
+template <class DataContainer>
+void QCPGraph::getVisibleDataBounds(const DataContainer *data, typename DataContainer::const_iterator &lower, typename DataContainer::const_iterator &upper) const
 {
   if (!mKeyAxis) { qDebug() << Q_FUNC_INFO << "invalid key axis"; return; }
-  if (mData->isEmpty())
+  if (data->isEmpty())
   {
-    lower = mData->constEnd();
-    upper = mData->constEnd();
+    lower = data->constEnd();
+    upper = data->constEnd();
     return;
   }
   
-  // get visible data range as QMap iterators
-  QCPDataMap::const_iterator lbound = mData->lowerBound(mKeyAxis.data()->range().lower);
-  QCPDataMap::const_iterator ubound = mData->upperBound(mKeyAxis.data()->range().upper);
-  bool lowoutlier = lbound != mData->constBegin(); // indicates whether there exist points below axis range
-  bool highoutlier = ubound != mData->constEnd(); // indicates whether there exist points above axis range
+  // get visible data range as container iterators
+  typename DataContainer::const_iterator lbound = data->lowerBound(mKeyAxis.data()->range().lower);
+  typename DataContainer::const_iterator ubound = data->upperBound(mKeyAxis.data()->range().upper);
+  bool lowoutlier = lbound != data->constBegin(); // indicates whether there exist points below axis range
+  bool highoutlier = ubound != data->constEnd(); // indicates whether there exist points above axis range
   
   lower = (lowoutlier ? lbound-1 : lbound); // data point range that will be actually drawn
   upper = (highoutlier ? ubound : ubound-1); // data point range that will be actually drawn
@@ -15979,6 +18082,236 @@ int QCPGraph::countDataInBounds(const QCPDataMap::const_iterator &lower, const Q
   return count;
 }
 
+/*! \internal \overload
+  
+  Counts the data points between \a lower and \a upper (including them) of the \ref QCPDataVector,
+  which takes constant time. The result is capped at \a maxCount like for the map.
+*/
+int QCPGraph::countDataInBounds(const QCPDataVector::const_iterator &lower, const QCPDataVector::const_iterator &upper, int maxCount) const
+{
+  if (upper == mDataVector->constEnd() && lower == mDataVector->constEnd())
+    return 0;
+  return qMin(upper-lower+1, maxCount);
+}
+
+/*! \internal
+  
+  Inserts \a data into the \ref QCPDataMap. A point whose key is not smaller than the last key of
+  the map is passed to the map with the end as position hint, which makes the insertion amortized
+  constant time instead of logarithmic (Qt 5.1 and newer).
+*/
+void QCPGraph::addMapData(const QCPData &data)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 1, 0)
+  if (mData->isEmpty() || !(data.key < (mData->constEnd()-1).key()))
+  {
+    mData->insertMulti(mData->constEnd(), data.key, data);
+    return;
+  }
+#endif
+  mData->insertMulti(data.key, data);
+}
+
+/*! \internal
+  
+  Discards the cached key and value ranges, so the next \ref getKeyRange or \ref getValueRange
+  call iterates the data again. Like the other two cache updates below, this also marks the hit
+  test points as outdated (see \ref pointDistance), since it's called on every data change. Direct
+  changes through \ref data or \ref vectorData reach it via \ref checkDataSignature.
+*/
+void QCPGraph::invalidateCachedRanges() const
+{
+  mHitSignature.clear();
+  for (int dimension=0; dimension<2; ++dimension)
+    for (int domain=0; domain<3; ++domain)
+      for (int errors=0; errors<2; ++errors)
+        mCachedRanges[dimension][domain][errors].valid = false;
+}
+
+/*! \internal
+  
+  Writes the number of data points and the first and last key of the current data storage to \a
+  count, \a firstKey and \a lastKey. Comparing these is how the caches notice changes made
+  directly through \ref data or \ref vectorData, see \ref checkDataSignature.
+*/
+void QCPGraph::dataSignature(int &count, double &firstKey, double &lastKey) const
+{
+  count = dataCount();
+  firstKey = 0;
+  lastKey = 0;
+  if (count == 0)
+    return;
+  if (mDataStorage == dsVector)
+  {
+    firstKey = mDataVector->key(0);
+    lastKey = mDataVector->key(count-1);
+  } else
+  {
+    firstKey = mData->constBegin().key();
+    lastKey = (mData->constEnd()-1).key();
+  }
+}
+
+/*! \internal
+  
+  Discards the cached ranges if the data doesn't match the signature stored with them, i.e. it was
+  changed directly through \ref data or \ref vectorData since the graph last saw it. Called before
+  the caches are read or updated. Changes that keep the number of points and the first and last
+  key aren't detected, see \ref dataChanged.
+*/
+void QCPGraph::checkDataSignature() const
+{
+  int count;
+  double firstKey, lastKey;
+  dataSignature(count, firstKey, lastKey);
+  // written so that NaN keys also discard the ranges:
+  if (!(count == mSignatureCount && firstKey == mSignatureFirstKey && lastKey == mSignatureLastKey))
+  {
+    invalidateCachedRanges();
+    mSignatureCount = count;
+    mSignatureFirstKey = firstKey;
+    mSignatureLastKey = lastKey;
+  }
+}
+
+/*! \internal
+  
+  Stores the signature of the current data with the cached ranges, after the graph's own methods
+  changed the data and updated the caches accordingly.
+*/
+void QCPGraph::storeDataSignature() const
+{
+  dataSignature(mSignatureCount, mSignatureFirstKey, mSignatureLastKey);
+}
+
+/*! \internal
+  
+  Extends the valid cached ranges by the point \a data, which is about to be added to the graph.
+*/
+void QCPGraph::addToCachedRanges(const QCPData &data)
+{
+  if (!mHitSignature.isEmpty())
+    mHitSignature.clear();
+  for (int dimension=0; dimension<2; ++dimension)
+  {
+    const double current = dimension == 0 ? data.key : data.value;
+    const double errorMinus = dimension == 0 ? data.keyErrorMinus : data.valueErrorMinus;
+    const double errorPlus = dimension == 0 ? data.keyErrorPlus : data.valueErrorPlus;
+    for (int domain=0; domain<3; ++domain)
+    {
+      for (int errors=0; errors<2; ++errors)
+      {
+        CachedRange &cache = mCachedRanges[dimension][domain][errors];
+        if (!cache.valid)
+          continue;
+        bool haveLower = cache.found;
+        bool haveUpper = cache.found;
+        extendRange(cache.range, haveLower, haveUpper, current, errors ? errorMinus : 0, errors ? errorPlus : 0, SignDomain(domain));
+        cache.found = haveLower && haveUpper;
+      }
+    }
+  }
+}
+
+/*! \internal
+  
+  Discards the cached ranges that the point \a data, which is about to be removed from the graph,
+  may have defined. Ranges that \a data lies strictly inside of stay valid.
+*/
+void QCPGraph::removeFromCachedRanges(const QCPData &data)
+{
+  if (!mHitSignature.isEmpty())
+    mHitSignature.clear();
+  for (int dimension=0; dimension<2; ++dimension)
+  {
+    const double current = dimension == 0 ? data.key : data.value;
+    const double errorMinus = dimension == 0 ? data.keyErrorMinus : data.valueErrorMinus;
+    const double errorPlus = dimension == 0 ? data.keyErrorPlus : data.valueErrorPlus;
+    for (int domain=0; domain<3; ++domain)
+    {
+      for (int errors=0; errors<2; ++errors)
+      {
+        CachedRange &cache = mCachedRanges[dimension][domain][errors];
+        if (!cache.valid || !cache.found)
+          continue;
+        const double lower = current-(errors ? errorMinus : 0);
+        const double upper = current+(errors ? errorPlus : 0);
+        // written so that NaN values also discard the range:
+        if (!(lower > cache.range.lower && upper < cache.range.upper && current > cache.range.lower && current < cache.range.upper))
+          cache.valid = false;
+      }
+    }
+  }
+}
+
+/*! \internal
+  
+  Extends \a range by a data point at \a current with the errors \a errorMinus and \a errorPlus
+  (pass 0 to ignore errors), considering only the sign domain \a inSignDomain. \a haveLower and
+  \a haveUpper tell whether \a range already has a lower and upper bound, and are updated. This is
+  the per-point step of \ref getKeyRange and \ref getValueRange.
+*/
+void QCPGraph::extendRange(QCPRange &range, bool &haveLower, bool &haveUpper, double current, double errorMinus, double errorPlus, SignDomain inSignDomain)
+{
+  const double lower = current-errorMinus;
+  const double upper = current+errorPlus;
+  if (inSignDomain == sdBoth) // range may be anywhere
+  {
+    if (lower < range.lower || !haveLower)
+    {
+      range.lower = lower;
+      haveLower = true;
+    }
+    if (upper > range.upper || !haveUpper)
+    {
+      range.upper = upper;
+      haveUpper = true;
+    }
+  } else // range may only be in the negative or positive sign domain
+  {
+    const bool negative = inSignDomain == sdNegative;
+    if ((lower < range.lower || !haveLower) && (negative ? lower < 0 : lower > 0))
+    {
+      range.lower = lower;
+      haveLower = true;
+    }
+    if ((upper > range.upper || !haveUpper) && (negative ? upper < 0 : upper > 0))
+    {
+      range.upper = upper;
+      haveUpper = true;
+    }
+    // in case point is in valid sign domain but error bars stretch beyond it, we still want to get that point:
+    if ((current < range.lower || !haveLower) && (negative ? current < 0 : current > 0))
+    {
+      range.lower = current;
+      haveLower = true;
+    }
+    if ((current > range.upper || !haveUpper) && (negative ? current < 0 : current > 0))
+    {
+      range.upper = current;
+      haveUpper = true;
+    }
+  }
+}
+
+/*! \internal
+  
+  Returns whether the graph holds any data points, in either storage mode.
+*/
+bool QCPGraph::hasData() const
+{
+  return mDataStorage == dsVector ? !mDataVector->isEmpty() : !mData->isEmpty();
+}
+
+/*! \internal
+  
+  Returns the number of data points of the graph, in either storage mode.
+*/
+int QCPGraph::dataCount() const
+{
+  return mDataStorage == dsVector ? mDataVector->size() : mData->size();
+}
+
 /*! \internal
   
   The line data vector generated by e.g. getLinePlotData contains only the line that connects the
@@ -16358,81 +18691,185 @@ int QCPGraph::findIndexAboveY(const QVector<QPointF> *data, double y) const
         return 0;
     }
   }
-  return -1;
+  return -1;
+}
+
+/*! \internal
+  
+  Calculates the (minimum) distance (in pixels) the graph's representation has from the given \a
+  pixelPoint in pixels. This is used to determine whether the graph was clicked or not, e.g. in
+  \ref selectTest.
+  
+  If either the graph has no data or if the line style is \ref lsNone and the scatter style's shape
+  is \ref QCPScatterStyle::ssNone (i.e. there is no visual representation of the graph), returns
+  500.
+  
+  Only the line segments passing through the pixel columns within the selection tolerance (\ref
+  QCustomPlot::setSelectionTolerance) of \a pixelPoint are considered, using the grid of \ref
+  updateHitTestGrid. So the cost doesn't depend on the number of data points, and the result is
+  exact for every distance a selection depends on. If no segment passes nearby, returns 500.
+*/
+double QCPGraph::pointDistance(const QPointF &pixelPoint) const
+{
+  if (!hasData())
+  {
+    qDebug() << Q_FUNC_INFO << "requested point distance on graph" << mName << "without data";
+    return 500;
+  }
+  if (dataCount() == 1)
+  {
+    QPointF dataPoint;
+    if (mDataStorage == dsVector)
+      dataPoint = coordsToPixels(mDataVector->key(0), mDataVector->value(0));
+    else
+      dataPoint = coordsToPixels(mData->constBegin().key(), mData->constBegin().value().value);
+    return QVector2D(dataPoint-pixelPoint).length();
+  }
+  
+  if (mLineStyle == lsNone && mScatterStyle.isNone())
+    return 500;
+  
+  // calculate minimum distance to the segments in the pixel columns around pixelPoint:
+  updateHitTestGrid();
+  const int columns = mHitColumnStart.size()-1;
+  if (columns < 1)
+    return 500;
+  const double position = mKeyAxis.data()->orientation() == Qt::Horizontal ? pixelPoint.x() : pixelPoint.y();
+  const int column = qFloor(position)-mHitColumnOrigin;
+  const int margin = mParentPlot->selectionTolerance()+1;
+  const int firstColumn = qBound(0, column-margin, columns-1);
+  const int lastColumn = qBound(0, column+margin, columns-1);
+  double minDistSqr = std::numeric_limits<double>::max();
+  for (int c=firstColumn; c<=lastColumn; ++c)
+  {
+    for (int k=mHitColumnStart.at(c); k<mHitColumnStart.at(c+1); ++k)
+    {
+      const int i = mHitColumnSegments.at(k);
+      double currentDistSqr = distSqrToLine(mHitPoints.at(i), mHitPoints.at(i+1), pixelPoint);
+      if (currentDistSqr < minDistSqr)
+        minDistSqr = currentDistSqr;
+    }
+  }
+  if (minDistSqr == std::numeric_limits<double>::max())
+    return 500;
+  return qSqrt(minDistSqr);
+}
+
+/*! \internal
+  
+  Transforms the keys and values of \a data to pixel coordinates along the key and value axis,
+  with one batch transformation per axis (see \ref QCPAxis::coordsToPixels).
+*/
+void QCPGraph::dataToPixels(const QVector<QCPData> &data, QVector<qreal> *keyPixels, QVector<qreal> *valuePixels) const
+{
+  const int dataStride = sizeof(QCPData)/sizeof(double);
+  keyPixels->resize(data.size());
+  valuePixels->resize(data.size());
+  if (data.isEmpty())
+    return;
+  mKeyAxis.data()->coordsToPixels(&data.constData()->key, dataStride, keyPixels->data(), 1, data.size());
+  mValueAxis.data()->coordsToPixels(&data.constData()->value, dataStride, valuePixels->data(), 1, data.size());
+}
+
+/*! \internal
+  
+  Returns the state that the pixel positions in the hit test cache depend on: ranges, scale types
+  and rects of both axes, as well as the line style and whether scatters are shown. The cache is
+  up to date if this equals the stored signature. Data changes clear the stored signature.
+  
+  \see pointDistance
+*/
+QVector<double> QCPGraph::hitTestSignature() const
+{
+  QVector<double> signature;
+  QCPAxis *axes[2] = {mKeyAxis.data(), mValueAxis.data()};
+  for (int i=0; i<2; ++i)
+  {
+    const QRect rect = axes[i]->axisRect()->rect();
+    signature << axes[i]->range().lower << axes[i]->range().upper << axes[i]->scaleType() << axes[i]->scaleLogBase()
+              << axes[i]->rangeReversed() << axes[i]->orientation() << rect.left() << rect.top() << rect.width() << rect.height();
+  }
+  signature << mLineStyle << mScatterStyle.isNone() << mAdaptiveSampling;
+  int count;
+  double firstKey, lastKey;
+  dataSignature(count, firstKey, lastKey);
+  signature << mDataStorage << count << firstKey << lastKey;
+  return signature;
 }
 
 /*! \internal
   
-  Calculates the (minimum) distance (in pixels) the graph's representation has from the given \a
-  pixelPoint in pixels. This is used to determine whether the graph was clicked or not, e.g. in
-  \ref selectTest.
+  Makes sure the hit test cache used by \ref pointDistance is up to date. That is the graph's
+  line in pixel coordinates (\a mHitPoints), and a bucket grid with one bucket per pixel column
+  of the axis rect along the key axis. Each bucket lists the segments of the line that pass
+  through that column, so a hit test only looks at the segments close to the clicked pixel.
   
-  If either the graph has no data or if the line style is \ref lsNone and the scatter style's shape
-  is \ref QCPScatterStyle::ssNone (i.e. there is no visual representation of the graph), returns
-  500.
+  The line is normally the one \ref draw kept from the last replot. It is only recomputed if the
+  data, the axes or the style changed since then (see \ref hitTestSignature). The grid is built
+  lazily on the first hit test after a replot, so replots during streaming don't pay for it.
+  
+  For line style \ref lsNone, the points are the visible scatters, connected in key order.
 */
-double QCPGraph::pointDistance(const QPointF &pixelPoint) const
+void QCPGraph::updateHitTestGrid() const
 {
-  if (mData->isEmpty())
-  {
-    qDebug() << Q_FUNC_INFO << "requested point distance on graph" << mName << "without data";
-    return 500;
-  }
-  if (mData->size() == 1)
+  const QVector<double> signature = hitTestSignature();
+  if (mHitSignature.isEmpty() || mHitSignature != signature)
   {
-    QPointF dataPoint = coordsToPixels(mData->constBegin().key(), mData->constBegin().value().value);
-    return QVector2D(dataPoint-pixelPoint).length();
+    mHitPoints.clear();
+    if (mLineStyle == lsNone)
+    {
+      QVector<QCPData> scatterData;
+      getScatterPlotData(&scatterData); // plot coordinates, so transform to pixels
+      mHitPoints.reserve(scatterData.size());
+      for (int i=0; i<scatterData.size(); ++i)
+        mHitPoints.append(coordsToPixels(scatterData.at(i).key, scatterData.at(i).value));
+    } else
+      getPlotData(&mHitPoints, 0); // unlike with getScatterPlotData we get pixel coordinates here
+    mHitSignature = signature;
+    mHitColumnStart.clear();
+    mHitColumnSegments.clear();
   }
+  if (!mHitColumnStart.isEmpty())
+    return;
   
-  if (mLineStyle == lsNone && mScatterStyle.isNone())
-    return 500;
+  const bool horizontal = mKeyAxis.data()->orientation() == Qt::Horizontal;
+  const QRect rect = mKeyAxis.data()->axisRect()->rect();
+  mHitColumnOrigin = horizontal ? rect.left() : rect.top();
+  const int columns = qMax(1, horizontal ? rect.width() : rect.height());
+  // impulse plot differs from other line styles in that the points are only pairwise connected:
+  const int step = mLineStyle == lsImpulse ? 2 : 1;
   
-  // calculate minimum distances to graph representation:
-  if (mLineStyle == lsNone)
+  // two passes, first count the segments of each column, then place them (compressed rows):
+  mHitColumnStart.fill(0, columns+1);
+  for (int pass=0; pass<2; ++pass)
   {
-    // no line displayed, only calculate distance to scatter points:
-    QVector<QCPData> *scatterData = new QVector<QCPData>;
-    getScatterPlotData(scatterData);
-    double minDistSqr = std::numeric_limits<double>::max();
-    QPointF ptA;
-    QPointF ptB = coordsToPixels(scatterData->at(0).key, scatterData->at(0).value); // getScatterPlotData returns in plot coordinates, so transform to pixels
-    for (int i=1; i<scatterData->size(); ++i)
+    QVector<int> fillPosition;
+    if (pass == 1)
     {
-      ptA = ptB;
-      ptB = coordsToPixels(scatterData->at(i).key, scatterData->at(i).value);
-      double currentDistSqr = distSqrToLine(ptA, ptB, pixelPoint);
-      if (currentDistSqr < minDistSqr)
-        minDistSqr = currentDistSqr;
+      for (int c=0; c<columns; ++c)
+        mHitColumnStart[c+1] += mHitColumnStart.at(c);
+      mHitColumnSegments.resize(mHitColumnStart.at(columns));
+      fillPosition = mHitColumnStart;
     }
-    delete scatterData;
-    return sqrt(minDistSqr);
-  } else
-  {
-    // line displayed calculate distance to line segments:
-    QVector<QPointF> *lineData = new QVector<QPointF>;
-    getPlotData(lineData, 0); // unlike with getScatterPlotData we get pixel coordinates here
-    double minDistSqr = std::numeric_limits<double>::max();
-    if (mLineStyle == lsImpulse)
-    {
-      // impulse plot differs from other line styles in that the lineData points are only pairwise connected:
-      for (int i=0; i<lineData->size()-1; i+=2) // iterate pairs
-      {
-        double currentDistSqr = distSqrToLine(lineData->at(i), lineData->at(i+1), pixelPoint);
-        if (currentDistSqr < minDistSqr)
-          minDistSqr = currentDistSqr;
-      }
-    } else
+    for (int i=0; i+1<mHitPoints.size(); i+=step)
     {
-      // all other line plots (line and step) connect points directly:
-      for (int i=0; i<lineData->size()-1; ++i)
+      double a = horizontal ? mHitPoints.at(i).x() : mHitPoints.at(i).y();
+      double b = horizontal ? mHitPoints.at(i+1).x() : mHitPoints.at(i+1).y();
+      if (qIsNaN(a) || qIsNaN(b))
+        continue;
+      if (a > b)
+        qSwap(a, b);
+      // segments beyond the rect go to the border columns, they may still be within the selection tolerance:
+      const int first = qFloor(qBound(double(mHitColumnOrigin), a, double(mHitColumnOrigin+columns-1)))-mHitColumnOrigin;
+      const int last = qFloor(qBound(double(mHitColumnOrigin), b, double(mHitColumnOrigin+columns-1)))-mHitColumnOrigin;
+      for (int c=first; c<=last; ++c)
       {
-        double currentDistSqr = distSqrToLine(lineData->at(i), lineData->at(i+1), pixelPoint);
-        if (currentDistSqr < minDistSqr)
-          minDistSqr = currentDistSqr;
+        if (pass == 0)
+          ++mHitColumnStart[c+1];
+        else
+          mHitColumnSegments[fillPosition[c]++] = i;
       }
     }
-    delete lineData;
-    return sqrt(minDistSqr);
   }
 }
 
@@ -16479,102 +18916,59 @@ QCPRange QCPGraph::getValueRange(bool &foundRange, SignDomain inSignDomain) cons
   
   Allows to specify whether the error bars should be included in the range calculation.
   
+  The result is cached per sign domain and error setting. Added data points only extend the cached
+  range, removed ones discard it only if they lay on its border, so rescaling axes during live
+  streaming doesn't iterate the data. Modifying the data via \ref data or \ref vectorData discards
+  the cache as soon as the number of points or the first or last key differ (see \ref
+  checkDataSignature). With the \ref dsVector storage, a discarded range over both sign domains without
+  errors is recomputed from the first and last key, so it's cheap even for a rolling window (\ref
+  setDataCapacity) that drops its first point with every append.
+  
   \see getKeyRange(bool &foundRange, SignDomain inSignDomain)
 */
 QCPRange QCPGraph::getKeyRange(bool &foundRange, SignDomain inSignDomain, bool includeErrors) const
+{
+  checkDataSignature();
+  CachedRange &cache = mCachedRanges[0][inSignDomain][includeErrors ? 1 : 0];
+  if (!cache.valid)
+  {
+    if (mDataStorage == dsVector && inSignDomain == sdBoth && !(includeErrors && mDataVector->hasErrors()) && !mDataVector->isEmpty() &&
+        !qIsNaN(mDataVector->key(0)) && !qIsNaN(mDataVector->key(mDataVector->size()-1)))
+    {
+      // keys are sorted, the first and the last one span the range:
+      cache.range = QCPRange(mDataVector->key(0), mDataVector->key(mDataVector->size()-1));
+      cache.found = true;
+    } else if (mDataStorage == dsVector)
+      cache.range = getKeyRange(mDataVector, cache.found, inSignDomain, includeErrors);
+    else
+      cache.range = getKeyRange(mData, cache.found, inSignDomain, includeErrors);
+    cache.valid = true;
+  }
+  foundRange = cache.found;
+  return cache.range;
+}
+
+/*! \internal
+  
+  Implementation of \ref getKeyRange for both data storage modes, \a data is the graph's \ref
+  QCPDataMap or its \ref QCPDataVector.
+*/
+template <class DataContainer>
+QCPRange QCPGraph::getKeyRange(const DataContainer *data, bool &foundRange, SignDomain inSignDomain, bool includeErrors) const
 {
   QCPRange range;
   bool haveLower = false;
   bool haveUpper = false;
   
-  double current, currentErrorMinus, currentErrorPlus;
-  
-  if (inSignDomain == sdBoth) // range may be anywhere
-  {
-    QCPDataMap::const_iterator it = mData->constBegin();
-    while (it != mData->constEnd())
-    {
-      current = it.value().key;
-      currentErrorMinus = (includeErrors ? it.value().keyErrorMinus : 0);
-      currentErrorPlus = (includeErrors ? it.value().keyErrorPlus : 0);
-      if (current-currentErrorMinus < range.lower || !haveLower)
-      {
-        range.lower = current-currentErrorMinus;
-        haveLower = true;
-      }
-      if (current+currentErrorPlus > range.upper || !haveUpper)
-      {
-        range.upper = current+currentErrorPlus;
-        haveUpper = true;
-      }
-      ++it;
-    }
-  } else if (inSignDomain == sdNegative) // range may only be in the negative sign domain
-  {
-    QCPDataMap::const_iterator it = mData->constBegin();
-    while (it != mData->constEnd())
-    {
-      current = it.value().key;
-      currentErrorMinus = (includeErrors ? it.value().keyErrorMinus : 0);
-      currentErrorPlus = (includeErrors ? it.value().keyErrorPlus : 0);
-      if ((current-currentErrorMinus < range.lower || !haveLower) && current-currentErrorMinus < 0)
-      {
-        range.lower = current-currentErrorMinus;
-        haveLower = true;
-      }
-      if ((current+currentErrorPlus > range.upper || !haveUpper) && current+currentErrorPlus < 0)
-      {
-        range.upper = current+currentErrorPlus;
-        haveUpper = true;
-      }
-      if (includeErrors) // in case point is in valid sign domain but errobars stretch beyond it, we still want to geht that point.
-      {
-        if ((current < range.lower || !haveLower) && current < 0)
-        {
-          range.lower = current;
-          haveLower = true;
-        }
-        if ((current > range.upper || !haveUpper) && current < 0)
-        {
-          range.upper = current;
-          haveUpper = true;
-        }
-      }
-      ++it;
-    }
-  } else if (inSignDomain == sdPositive) // range may only be in the positive sign domain
+  typename DataContainer::const_iterator it = data->constBegin();
+  while (it != data->constEnd())
   {
-    QCPDataMap::const_iterator it = mData->constBegin();
-    while (it != mData->constEnd())
-    {
-      current = it.value().key;
-      currentErrorMinus = (includeErrors ? it.value().keyErrorMinus : 0);
-      currentErrorPlus = (includeErrors ? it.value().keyErrorPlus : 0);
-      if ((current-currentErrorMinus < range.lower || !haveLower) && current-currentErrorMinus > 0)
-      {
-        range.lower = current-currentErrorMinus;
-        haveLower = true;
-      }
-      if ((current+currentErrorPlus > range.upper || !haveUpper) && current+currentErrorPlus > 0)
-      {
-        range.upper = current+currentErrorPlus;
-        haveUpper = true;
-      }
-      if (includeErrors) // in case point is in valid sign domain but errobars stretch beyond it, we still want to get that point.
-      {
-        if ((current < range.lower || !haveLower) && current > 0)
-        {
-          range.lower = current;
-          haveLower = true;
-        }
-        if ((current > range.upper || !haveUpper) && current > 0)
-        {
-          range.upper = current;
-          haveUpper = true;
-        }
-      }
-      ++it;
-    }
+    const QCPData point = it.value();
+    if (includeErrors)
+      extendRange(range, haveLower, haveUpper, point.key, point.keyErrorMinus, point.keyErrorPlus, inSignDomain);
+    else
+      extendRange(range, haveLower, haveUpper, point.key, 0, 0, inSignDomain);
+    ++it;
   }
   
   foundRange = haveLower && haveUpper;
@@ -16583,104 +18977,62 @@ QCPRange QCPGraph::getKeyRange(bool &foundRange, SignDomain inSignDomain, bool i
 
 /*! \overload
   
-  Allows to specify whether the error bars should be included in the range calculation.
+  Allows to specify whether the error bars should be included in the range calculation. The result
+  is cached like the one of \ref getKeyRange(bool &foundRange, SignDomain inSignDomain, bool includeErrors) const.
+  With the \ref dsVector storage, a discarded range over both sign domains without errors is
+  recomputed from the vector's min/max pyramid (\ref QCPDataVector::valueBounds) in logarithmic
+  time.
   
   \see getValueRange(bool &foundRange, SignDomain inSignDomain)
 */
 QCPRange QCPGraph::getValueRange(bool &foundRange, SignDomain inSignDomain, bool includeErrors) const
 {
-  QCPRange range;
-  bool haveLower = false;
-  bool haveUpper = false;
-  
-  double current, currentErrorMinus, currentErrorPlus;
-  
-  if (inSignDomain == sdBoth) // range may be anywhere
+  checkDataSignature();
+  CachedRange &cache = mCachedRanges[1][inSignDomain][includeErrors ? 1 : 0];
+  if (!cache.valid)
   {
-    QCPDataMap::const_iterator it = mData->constBegin();
-    while (it != mData->constEnd())
+    double minValue = 0, maxValue = 0;
+    bool pyramid = mDataStorage == dsVector && inSignDomain == sdBoth && !(includeErrors && mDataVector->hasErrors()) && !mDataVector->isEmpty();
+    if (pyramid)
     {
-      current = it.value().value;
-      currentErrorMinus = (includeErrors ? it.value().valueErrorMinus : 0);
-      currentErrorPlus = (includeErrors ? it.value().valueErrorPlus : 0);
-      if (current-currentErrorMinus < range.lower || !haveLower)
-      {
-        range.lower = current-currentErrorMinus;
-        haveLower = true;
-      }
-      if (current+currentErrorPlus > range.upper || !haveUpper)
-      {
-        range.upper = current+currentErrorPlus;
-        haveUpper = true;
-      }
-      ++it;
+      mDataVector->valueBounds(0, mDataVector->size(), minValue, maxValue);
+      pyramid = !qIsNaN(minValue) && !qIsNaN(maxValue); // like adaptive sampling, the pyramid assumes values without NaN; iterate if it saw one
     }
-  } else if (inSignDomain == sdNegative) // range may only be in the negative sign domain
-  {
-    QCPDataMap::const_iterator it = mData->constBegin();
-    while (it != mData->constEnd())
+    if (pyramid)
     {
-      current = it.value().value;
-      currentErrorMinus = (includeErrors ? it.value().valueErrorMinus : 0);
-      currentErrorPlus = (includeErrors ? it.value().valueErrorPlus : 0);
-      if ((current-currentErrorMinus < range.lower || !haveLower) && current-currentErrorMinus < 0)
-      {
-        range.lower = current-currentErrorMinus;
-        haveLower = true;
-      }
-      if ((current+currentErrorPlus > range.upper || !haveUpper) && current+currentErrorPlus < 0)
-      {
-        range.upper = current+currentErrorPlus;
-        haveUpper = true;
-      }
-      if (includeErrors) // in case point is in valid sign domain but errobars stretch beyond it, we still want to get that point.
-      {
-        if ((current < range.lower || !haveLower) && current < 0)
-        {
-          range.lower = current;
-          haveLower = true;
-        }
-        if ((current > range.upper || !haveUpper) && current < 0)
-        {
-          range.upper = current;
-          haveUpper = true;
-        }
-      }
-      ++it;
-    }
-  } else if (inSignDomain == sdPositive) // range may only be in the positive sign domain
+      cache.range = QCPRange(minValue, maxValue);
+      cache.found = true;
+    } else if (mDataStorage == dsVector)
+      cache.range = getValueRange(mDataVector, cache.found, inSignDomain, includeErrors);
+    else
+      cache.range = getValueRange(mData, cache.found, inSignDomain, includeErrors);
+    cache.valid = true;
+  }
+  foundRange = cache.found;
+  return cache.range;
+}
+
+/*! \internal
+  
+  Implementation of \ref getValueRange for both data storage modes, \a data is the graph's \ref
+  QCPDataMap or its \ref QCPDataVector.
+*/
+template <class DataContainer>
+QCPRange QCPGraph::getValueRange(const DataContainer *data, bool &foundRange, SignDomain inSignDomain, bool includeErrors) const
+{
+  QCPRange range;
+  bool haveLower = false;
+  bool haveUpper = false;
+  
+  typename DataContainer::const_iterator it = data->constBegin();
+  while (it != data->constEnd())
   {
-    QCPDataMap::const_iterator it = mData->constBegin();
-    while (it != mData->constEnd())
-    {
-      current = it.value().value;
-      currentErrorMinus = (includeErrors ? it.value().valueErrorMinus : 0);
-      currentErrorPlus = (includeErrors ? it.value().valueErrorPlus : 0);
-      if ((current-currentErrorMinus < range.lower || !haveLower) && current-currentErrorMinus > 0)
-      {
-        range.lower = current-currentErrorMinus;
-        haveLower = true;
-      }
-      if ((current+currentErrorPlus > range.upper || !haveUpper) && current+currentErrorPlus > 0)
-      {
-        range.upper = current+currentErrorPlus;
-        haveUpper = true;
-      }
-      if (includeErrors) // in case point is in valid sign domain but errobars stretch beyond it, we still want to geht that point.
-      {
-        if ((current < range.lower || !haveLower) && current > 0)
-        {
-          range.lower = current;
-          haveLower = true;
-        }
-        if ((current > range.upper || !haveUpper) && current > 0)
-        {
-          range.upper = current;
-          haveUpper = true;
-        }
-      }
-      ++it;
-    }
+    const QCPData point = it.value();
+    if (includeErrors)
+      extendRange(range, haveLower, haveUpper, point.value, point.valueErrorMinus, point.valueErrorPlus, inSignDomain);
+    else
+      extendRange(range, haveLower, haveUpper, point.value, 0, 0, inSignDomain);
+    ++it;
   }
   
   foundRange = haveLower && haveUpper;
@@ -17154,7 +19506,13 @@ void QCPCurve::getCurveData(QVector<QPointF> *lineData) const
   if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
   
   QRect axisRect = mKeyAxis.data()->axisRect()->rect() & mValueAxis.data()->axisRect()->rect();
-  lineData->reserve(mData->size());
+  // the kept points are collected in plot coordinates first and transformed in one batch at the end.
+  // region is 0 for points that keep their position, else the region they are moved to the border of:
+  QVector<double> keys, values;
+  QVector<int> regions;
+  keys.reserve(mData->size());
+  values.reserve(mData->size());
+  regions.reserve(mData->size());
   QCPCurveDataMap::const_iterator it;
   int lastRegion = 5;
   int currentRegion = 5;
@@ -17206,17 +19564,27 @@ void QCPCurve::getCurveData(QVector<QPointF> *lineData) const
     if (currentRegion == 5 || (firstPoint && mBrush.style() != Qt::NoBrush)) // current is in R, add current and last if it wasn't added already
     {
       if (!addedLastAlready) // in case curve just entered R, make sure the last point outside R is also drawn correctly
-        lineData->append(coordsToPixels((it-1).value().key, (it-1).value().value)); // add last point to vector
+      {
+        keys.append((it-1).value().key); // add last point to vector
+        values.append((it-1).value().value);
+        regions.append(0);
+      }
       else if (lastRegion != 5) // added last already. If that's the case, we probably added it at optimized position. So go back and make sure it's at original position (else the angle changes under which this segment enters R)
       {
         if (!firstPoint) // because on firstPoint, currentRegion is 5 and addedLastAlready is true, although there is no last point
-          lineData->replace(lineData->size()-1, coordsToPixels((it-1).value().key, (it-1).value().value));
+        {
+          keys.last() = (it-1).value().key;
+          values.last() = (it-1).value().value;
+          regions.last() = 0;
+        }
       }
-      lineData->append(coordsToPixels(it.value().key, it.value().value)); // add current point to vector
+      keys.append(it.value().key); // add current point to vector
+      values.append(it.value().value);
+      regions.append(0);
       addedLastAlready = true; // so in next iteration, we don't add this point twice
     } else if (currentRegion != lastRegion) // changed region, add current and last if not added already
     {
-      // using outsideCoordsToPixels instead of coorsToPixels for optimized point placement (places points just outside axisRect instead of potentially far away)
+      // using moveOutsideAxisRect for optimized point placement (places points just outside axisRect instead of potentially far away)
       
       // if we're coming from R or we skip diagonally over the corner regions (so line might still be visible in R), we can't place points optimized
       if (lastRegion == 5 || // coming from R
@@ -17228,16 +19596,28 @@ void QCPCurve::getCurveData(QVector<QPointF> *lineData) const
       {
         // always add last point if not added already, original:
         if (!addedLastAlready)
-          lineData->append(coordsToPixels((it-1).value().key, (it-1).value().value));
+        {
+          keys.append((it-1).value().key);
+          values.append((it-1).value().value);
+          regions.append(0);
+        }
         // add current point, original:
-        lineData->append(coordsToPixels(it.value().key, it.value().value));
+        keys.append(it.value().key);
+        values.append(it.value().value);
+        regions.append(0);
       } else // no special case that forbids optimized point placement, so do it:
       {
         // always add last point if not added already, optimized:
         if (!addedLastAlready)
-          lineData->append(outsideCoordsToPixels((it-1).value().key, (it-1).value().value, currentRegion, axisRect));
+        {
+          keys.append((it-1).value().key);
+          values.append((it-1).value().value);
+          regions.append(currentRegion);
+        }
         // add current point, optimized:
-        lineData->append(outsideCoordsToPixels(it.value().key, it.value().value, currentRegion, axisRect));
+        keys.append(it.value().key);
+        values.append(it.value().value);
+        regions.append(currentRegion);
       }
       addedLastAlready = true; // so that if next point enters 5, or crosses another region boundary, we don't add this point twice
     } else // neither in R, nor crossed a region boundary, skip current point
@@ -17249,7 +19629,25 @@ void QCPCurve::getCurveData(QVector<QPointF> *lineData) const
   }
   // If curve ends outside R, we want to add very last point so the fill looks like it should when the curve started inside R:
   if (lastRegion != 5 && mBrush.style() != Qt::NoBrush && !mData->isEmpty())
-    lineData->append(coordsToPixels((mData->constEnd()-1).value().key, (mData->constEnd()-1).value().value));
+  {
+    keys.append((mData->constEnd()-1).value().key);
+    values.append((mData->constEnd()-1).value().value);
+    regions.append(0);
+  }
+  
+  // transform the kept points to pixels, straight into the x and y coordinates of lineData:
+  lineData->resize(keys.size());
+  if (keys.isEmpty())
+    return;
+  qreal *points = &lineData->data()->rx();
+  const int keyOffset = keyAxis->orientation() == Qt::Vertical ? 1 : 0;
+  keyAxis->coordsToPixels(keys.constData(), 1, points+keyOffset, 2, keys.size());
+  valueAxis->coordsToPixels(values.constData(), 1, points+1-keyOffset, 2, values.size());
+  for (int i=0; i<regions.size(); ++i)
+  {
+    if (regions.at(i) != 0)
+      moveOutsideAxisRect(&(*lineData)[i], regions.at(i), axisRect);
+  }
 }
 
 /*! \internal
@@ -17287,19 +19685,19 @@ double QCPCurve::pointDistance(const QPointF &pixelPoint) const
 
 /*! \internal
   
-  This is a specialized \ref coordsToPixels function for points that are outside the visible
-  axisRect and just crossing a boundary (since \ref getCurveData reduces non-visible curve segments
-  to those line segments that cross region boundaries, see documentation there). It only uses the
-  coordinate parallel to the region boundary of the axisRect. The other coordinate is picked just
-  outside the axisRect (how far is determined by the scatter size and the line width). Together
-  with the optimization in \ref getCurveData this improves performance for large curves (or zoomed
-  in ones) significantly while keeping the illusion the whole curve and its filling is still being
-  drawn for the viewer.
+  This moves \a pixelPoint, the pixel position of a point that is outside the visible axisRect and
+  just crossing a boundary, onto that boundary (since \ref getCurveData reduces non-visible curve
+  segments to those line segments that cross region boundaries, see documentation there). It only
+  keeps the coordinate parallel to the region boundary of the axisRect. The other coordinate is
+  picked just outside the axisRect (how far is determined by the scatter size and the line width).
+  Together with the optimization in \ref getCurveData this improves performance for large curves
+  (or zoomed in ones) significantly while keeping the illusion the whole curve and its filling is
+  still being drawn for the viewer.
 */
-QPointF QCPCurve::outsideCoordsToPixels(double key, double value, int region, QRect axisRect) const
+void QCPCurve::moveOutsideAxisRect(QPointF *pixelPoint, int region, QRect axisRect) const
 {
   int margin = qCeil(qMax(mScatterStyle.size(), (double)mPen.widthF())) + 2;
-  QPointF result = coordsToPixels(key, value);
+  QPointF &result = *pixelPoint;
   switch (region)
   {
     case 2: result.setX(axisRect.left()-margin); break; // left
@@ -17315,7 +19713,6 @@ QPointF QCPCurve::outsideCoordsToPixels(double key, double value, int region, QR
     case 3: result.setX(axisRect.left()-margin);
             result.setY(axisRect.bottom()+margin); break; // bottom left
   }
-  return result;
 }
 
 /* inherits documentation from base class */
@@ -18440,6 +20837,10 @@ QCPRange QCPStatisticalBox::getValueRange(bool &foundRange, SignDomain inSignDom
   true current minimum and maximum. The method QCPColorMap::rescaleDataRange offers a convenience
   parameter \a recalculateDataBounds which may be set to true to automatically call \ref
   recalculateDataBounds internally.
+  
+  For data that grows row by row, like a waterfall of consecutive measurement cycles, \ref
+  appendRow scrolls the map by one value cell and sets the new top row. Rows aren't moved in memory
+  for this, and the QCPColorMap only colorizes the new rows for its next replot.
 */
 
 /* start of documentation of inline functions */
@@ -18466,7 +20867,9 @@ QCPColorMapData::QCPColorMapData(int keySize, int valueSize, const QCPRange &key
   mValueRange(valueRange),
   mIsEmpty(true),
   mData(0),
-  mDataModified(true)
+  mDataModified(true),
+  mFirstRow(0),
+  mAppendedRows(0)
 {
   setSize(keySize, valueSize);
   fill(0);
@@ -18486,7 +20889,9 @@ QCPColorMapData::QCPColorMapData(const QCPColorMapData &other) :
   mValueSize(0),
   mIsEmpty(true),
   mData(0),
-  mDataModified(true)
+  mDataModified(true),
+  mFirstRow(0),
+  mAppendedRows(0)
 {
   *this = other;
 }
@@ -18504,6 +20909,7 @@ QCPColorMapData &QCPColorMapData::operator=(const QCPColorMapData &other)
     setRange(other.keyRange(), other.valueRange());
     if (!mIsEmpty)
       memcpy(mData, other.mData, sizeof(mData[0])*keySize*valueSize);
+    mFirstRow = other.mFirstRow;
     mDataBounds = other.mDataBounds;
     mDataModified = true;
   }
@@ -18516,7 +20922,7 @@ double QCPColorMapData::data(double key, double value)
   int keyCell = (key-mKeyRange.lower)/(mKeyRange.upper-mKeyRange.lower)*(mKeySize-1)+0.5;
   int valueCell = (1.0-(value-mValueRange.lower)/(mValueRange.upper-mValueRange.lower))*(mValueSize-1)+0.5;
   if (keyCell >= 0 && keyCell < mKeySize && valueCell >= 0 && valueCell < mValueSize)
-    return mData[valueCell*mKeySize + keyCell];
+    return mData[cellIndex(keyCell, valueCell)];
   else
     return 0;
 }
@@ -18525,7 +20931,7 @@ double QCPColorMapData::data(double key, double value)
 double QCPColorMapData::cell(int keyIndex, int valueIndex)
 {
   if (keyIndex >= 0 && keyIndex < mKeySize && valueIndex >= 0 && valueIndex < mValueSize)
-    return mData[valueIndex*mKeySize + keyIndex];
+    return mData[cellIndex(keyIndex, valueIndex)];
   else
     return 0;
 }
@@ -18566,6 +20972,7 @@ void QCPColorMapData::setSize(int keySize, int valueSize)
         qDebug() << Q_FUNC_INFO << "out of memory for data dimensions "<< mKeySize << "*" << mValueSize;
     } else
       mData = 0;
+    mFirstRow = 0;
     mDataModified = true;
   }
 }
@@ -18658,7 +21065,7 @@ void QCPColorMapData::setData(double key, double value, double z)
   int valueCell = (value-mValueRange.lower)/(mValueRange.upper-mValueRange.lower)*(mValueSize-1)+0.5;
   if (keyCell >= 0 && keyCell < mKeySize && valueCell >= 0 && valueCell < mValueSize)
   {
-    mData[valueCell*mKeySize + keyCell] = z;
+    mData[cellIndex(keyCell, valueCell)] = z;
     if (z < mDataBounds.lower)
       mDataBounds.lower = z;
     if (z > mDataBounds.upper)
@@ -18682,7 +21089,7 @@ void QCPColorMapData::setCell(int keyIndex, int valueIndex, double z)
 {
   if (keyIndex >= 0 && keyIndex < mKeySize && valueIndex >= 0 && valueIndex < mValueSize)
   {
-    mData[valueIndex*mKeySize + keyIndex] = z;
+    mData[cellIndex(keyIndex, valueIndex)] = z;
     if (z < mDataBounds.lower)
       mDataBounds.lower = z;
     if (z > mDataBounds.upper)
@@ -18691,6 +21098,49 @@ void QCPColorMapData::setCell(int keyIndex, int valueIndex, double z)
   }
 }
 
+/*!
+  Scrolls the map by one cell in the value dimension and sets the cells of the new row at the upper
+  value end to \a row, which must hold \ref keySize values. The row at value index 0 is dropped and
+  every other row moves down by one value index. The value range (\ref setValueRange) moves up by
+  one cell along with them, so every row keeps its plot coordinate.
+  
+  This is meant for maps that grow one row at a time, e.g. one row per measurement cycle. The rows
+  aren't moved in memory, the new row takes the place of the dropped one, so appending costs the
+  same as setting one row of cells, independent of \ref valueSize. A QCPColorMap showing this data
+  only colorizes the appended rows on its next replot instead of the whole map.
+  
+  The buffered data bounds are extended by the new values, like with \ref setCell.
+  
+  \see setCell
+*/
+void QCPColorMapData::appendRow(const QVector<double> &row)
+{
+  if (mIsEmpty || !mData)
+    return;
+  if (row.size() != mKeySize)
+  {
+    qDebug() << Q_FUNC_INFO << "Row size" << row.size() << "doesn't match key size" << mKeySize;
+    return;
+  }
+  
+  double *cells = mData + mFirstRow*mKeySize; // the dropped row at value index 0
+  for (int i=0; i<mKeySize; ++i)
+  {
+    const double z = row.at(i);
+    cells[i] = z;
+    if (z < mDataBounds.lower)
+      mDataBounds.lower = z;
+    if (z > mDataBounds.upper)
+      mDataBounds.upper = z;
+  }
+  if (++mFirstRow == mValueSize)
+    mFirstRow = 0;
+  if (mAppendedRows < mValueSize)
+    ++mAppendedRows;
+  if (mValueSize > 1)
+    mValueRange += mValueRange.size()/(double)(mValueSize-1);
+}
+
 /*!
   Goes through the data and updates the buffered minimum and maximum data values.
   
@@ -18782,6 +21232,19 @@ void QCPColorMapData::cellToCoord(int keyIndex, int valueIndex, double *key, dou
     *value = valueIndex/(double)(mValueSize-1)*(mValueRange.upper-mValueRange.lower)+mValueRange.lower;
 }
 
+/*! \internal
+  
+  Returns the index in mData of the cell with indices \a keyIndex and \a valueIndex. The rows of
+  mData are a ring that starts at mFirstRow, see \ref appendRow.
+*/
+int QCPColorMapData::cellIndex(int keyIndex, int valueIndex) const
+{
+  int row = valueIndex+mFirstRow;
+  if (row >= mValueSize)
+    row -= mValueSize;
+  return row*mKeySize + keyIndex;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////// QCPColorMap
@@ -19114,7 +21577,11 @@ void QCPColorMap::updateLegendIcon(Qt::TransformationMode transformMode, const Q
   {
     bool mirrorX = (keyAxis()->orientation() == Qt::Horizontal ? keyAxis() : valueAxis())->rangeReversed();
     bool mirrorY = (valueAxis()->orientation() == Qt::Vertical ? valueAxis() : keyAxis())->rangeReversed();
-    mLegendIcon = QPixmap::fromImage(mMapImage.mirrored(mirrorX, mirrorY)).scaled(thumbSize, Qt::KeepAspectRatio, transformMode);
+    QImage icon(mMapImage.size(), mMapImage.format());
+    QPainter iconPainter(&icon);
+    drawMapImage(&iconPainter, icon.rect(), mirrorX, mirrorY);
+    iconPainter.end();
+    mLegendIcon = QPixmap::fromImage(icon).scaled(thumbSize, Qt::KeepAspectRatio, transformMode);
   }
 }
 
@@ -19190,9 +21657,111 @@ void QCPColorMap::updateMapImage()
   }
   
   mMapData->mDataModified = false;
+  mMapData->mAppendedRows = 0;
   mMapImageInvalidated = false;
 }
 
+/*! \internal
+  
+  Colorizes only the rows that were added with \ref QCPColorMapData::appendRow since the map image
+  was last updated. The image rows correspond to the rows of the data array, so a new row replaces
+  the image row of the row it dropped and the rest of the image stays as it is. \ref
+  drawMapImage puts the rows back in value order for drawing.
+  
+  This method is called by \ref QCPColorMap::draw instead of \ref updateMapImage when rows were
+  appended and nothing else changed.
+*/
+void QCPColorMap::updateAppendedRows()
+{
+  QCPAxis *keyAxis = mKeyAxis.data();
+  if (!keyAxis) return;
+  
+  const int keySize = mMapData->keySize();
+  const int valueSize = mMapData->valueSize();
+  const bool horizontal = keyAxis->orientation() == Qt::Horizontal;
+  if (mMapImage.size() != (horizontal ? QSize(keySize, valueSize) : QSize(valueSize, keySize)))
+  {
+    updateMapImage(); // the key axis orientation changed since the last update
+    return;
+  }
+  
+  const double *rawData = mMapData->mData;
+  const bool logarithmic = mDataScaleType==QCPAxis::stLogarithmic;
+  QVector<QRgb> column(horizontal ? 0 : keySize);
+  for (int i=mMapData->mAppendedRows; i>0; --i)
+  {
+    int row = mMapData->mFirstRow-i; // data row holding the value index valueSize-i
+    if (row < 0)
+      row += valueSize;
+    if (horizontal)
+    {
+      QRgb* pixels = reinterpret_cast<QRgb*>(mMapImage.scanLine(valueSize-1-row)); // scanlines count from top, see updateMapImage
+      mGradient.colorize(rawData+row*keySize, mDataRange, pixels, keySize, 1, logarithmic);
+    } else // keyAxis->orientation() == Qt::Vertical, the row is an image column
+    {
+      mGradient.colorize(rawData+row*keySize, mDataRange, column.data(), keySize, 1, logarithmic);
+      for (int key=0; key<keySize; ++key)
+        reinterpret_cast<QRgb*>(mMapImage.scanLine(keySize-1-key))[row] = column.at(key);
+    }
+  }
+  mMapData->mAppendedRows = 0;
+}
+
+/*! \internal
+  
+  Draws the map image into \a targetRect with \a painter, mirrored horizontally and vertically as
+  given by \a mirrorX and \a mirrorY. After \ref QCPColorMapData::appendRow, the image rows are a
+  ring just like the rows of the data array. The two parts of the ring are then drawn into their
+  place in value order separately, so a scrolled map isn't copied for drawing.
+*/
+void QCPColorMap::drawMapImage(QPainter *painter, const QRectF &targetRect, bool mirrorX, bool mirrorY) const
+{
+  const int first = mMapData->mFirstRow;
+  const int width = mMapImage.width();
+  const int height = mMapImage.height();
+  const bool horizontal = !mKeyAxis || mKeyAxis.data()->orientation() == Qt::Horizontal;
+  if (first == 0 || mMapImage.size() != (horizontal ? QSize(mMapData->keySize(), mMapData->valueSize()) : QSize(mMapData->valueSize(), mMapData->keySize())))
+  {
+    // not scrolled, or not updated yet since the data was resized:
+    painter->drawImage(targetRect, mMapImage.mirrored(mirrorX, mirrorY));
+    return;
+  }
+  
+  // source rects of the two parts, and where they go in the image in value order:
+  QRect sourceA, sourceB, targetA, targetB;
+  if (horizontal) // the highest value index is at the top, at scanline height-first
+  {
+    sourceA = QRect(0, height-first, width, first);
+    targetA = QRect(0, 0, width, first);
+    sourceB = QRect(0, 0, width, height-first);
+    targetB = QRect(0, first, width, height-first);
+  } else // rows are image columns, value index 0 at the left
+  {
+    sourceA = QRect(first, 0, width-first, height);
+    targetA = QRect(0, 0, width-first, height);
+    sourceB = QRect(0, 0, first, height);
+    targetB = QRect(width-first, 0, first, height);
+  }
+  
+  // draw in image coordinates, the transformation does the scaling and mirroring:
+  painter->save();
+  painter->translate(targetRect.topLeft());
+  painter->scale(targetRect.width()/(double)width, targetRect.height()/(double)height);
+  if (mirrorX)
+  {
+    painter->translate(width, 0);
+    painter->scale(-1, 1);
+  }
+  if (mirrorY)
+  {
+    painter->translate(0, height);
+    painter->scale(1, -1);
+  }
+  painter->drawImage(targetA, mMapImage, sourceA);
+  painter->drawImage(targetB, mMapImage, sourceB);
+  painter->restore();
+}
+
 /* inherits documentation from base class */
 void QCPColorMap::draw(QCPPainter *painter)
 {
@@ -19202,6 +21771,8 @@ void QCPColorMap::draw(QCPPainter *painter)
   
   if (mMapData->mDataModified || mMapImageInvalidated)
     updateMapImage();
+  else if (mMapData->mAppendedRows > 0)
+    updateAppendedRows();
   
   double halfSampleKey = 0;
   double halfSampleValue = 0;
@@ -19223,7 +21794,7 @@ void QCPColorMap::draw(QCPPainter *painter)
     painter->setClipRect(QRectF(coordsToPixels(mMapData->keyRange().lower, mMapData->valueRange().lower),
                                 coordsToPixels(mMapData->keyRange().upper, mMapData->valueRange().upper)).normalized(), Qt::IntersectClip);
   }
-  painter->drawImage(imageRect, mMapImage.mirrored(mirrorX, mirrorY));
+  drawMapImage(painter, imageRect, mirrorX, mirrorY);
   if (mTightBoundary)
     painter->setClipRegion(clipBackup);
   painter->setRenderHint(QPainter::SmoothPixmapTransform, smoothBackup);
@@ -21089,46 +23660,60 @@ void QCPItemTracer::updatePosition()
   {
     if (mParentPlot->hasPlottable(mGraph))
     {
-      if (mGraph->data()->size() > 1)
+      if (mGraph->dataStorage() == QCPGraph::dsVector)
+        updateGraphPosition(mGraph->mDataVector);
+      else
+        updateGraphPosition(mGraph->mData);
+    } else
+      qDebug() << Q_FUNC_INFO << "graph not contained in QCustomPlot instance (anymore)";
+  }
+}
+
+/*! \internal
+  
+  Places the tracer on the graph \a data, which is the graph's \ref QCPDataMap or its \ref
+  QCPDataVector depending on \ref QCPGraph::setDataStorage. Called by \ref updatePosition.
+*/
+template <class DataContainer>
+void QCPItemTracer::updateGraphPosition(const DataContainer *data)
+{
+  if (data->size() > 1)
+  {
+    typename DataContainer::const_iterator first = data->constBegin();
+    typename DataContainer::const_iterator last = data->constEnd()-1;
+    if (mGraphKey < first.key())
+      position->setCoords(first.key(), first.value().value);
+    else if (mGraphKey > last.key())
+      position->setCoords(last.key(), last.value().value);
+    else
+    {
+      typename DataContainer::const_iterator it = data->lowerBound(mGraphKey);
+      if (it != first) // mGraphKey is somewhere between iterators
       {
-        QCPDataMap::const_iterator first = mGraph->data()->constBegin();
-        QCPDataMap::const_iterator last = mGraph->data()->constEnd()-1;
-        if (mGraphKey < first.key())
-          position->setCoords(first.key(), first.value().value);
-        else if (mGraphKey > last.key())
-          position->setCoords(last.key(), last.value().value);
-        else
+        typename DataContainer::const_iterator prevIt = it-1;
+        if (mInterpolating)
         {
-          QCPDataMap::const_iterator it = mGraph->data()->lowerBound(mGraphKey);
-          if (it != first) // mGraphKey is somewhere between iterators
-          {
-            QCPDataMap::const_iterator prevIt = it-1;
-            if (mInterpolating)
-            {
-              // interpolate between iterators around mGraphKey:
-              double slope = 0;
-              if (!qFuzzyCompare((double)it.key(), (double)prevIt.key()))
-                slope = (it.value().value-prevIt.value().value)/(it.key()-prevIt.key());
-              position->setCoords(mGraphKey, (mGraphKey-prevIt.key())*slope+prevIt.value().value);
-            } else
-            {
-              // find iterator with key closest to mGraphKey:
-              if (mGraphKey < (prevIt.key()+it.key())*0.5)
-                it = prevIt;
-              position->setCoords(it.key(), it.value().value);
-            }
-          } else // mGraphKey is exactly on first iterator
-            position->setCoords(it.key(), it.value().value);
+          // interpolate between iterators around mGraphKey:
+          double slope = 0;
+          if (!qFuzzyCompare((double)it.key(), (double)prevIt.key()))
+            slope = (it.value().value-prevIt.value().value)/(it.key()-prevIt.key());
+          position->setCoords(mGraphKey, (mGraphKey-prevIt.key())*slope+prevIt.value().value);
+        } else
+        {
+          // find iterator with key closest to mGraphKey:
+          if (mGraphKey < (prevIt.key()+it.key())*0.5)
+            it = prevIt;
+          position->setCoords(it.key(), it.value().value);
         }
-      } else if (mGraph->data()->size() == 1)
-      {
-        QCPDataMap::const_iterator it = mGraph->data()->constBegin();
+      } else // mGraphKey is exactly on first iterator
         position->setCoords(it.key(), it.value().value);
-      } else
-        qDebug() << Q_FUNC_INFO << "graph has no data";
-    } else
-      qDebug() << Q_FUNC_INFO << "graph not contained in QCustomPlot instance (anymore)";
-  }
+    }
+  } else if (data->size() == 1)
+  {
+    typename DataContainer::const_iterator it = data->constBegin();
+    position->setCoords(it.key(), it.value().value);
+  } else
+    qDebug() << Q_FUNC_INFO << "graph has no data";
 }
 
 /*! \internal
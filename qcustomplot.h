@@ -43,8 +43,20 @@
 #include <QStack>
 #include <QCache>
 #include <QMargins>
+#include <QPair>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QPicture>
+#include <QImage>
 #include <qmath.h>
 #include <limits>
+#include <algorithm>
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
 #  include <qnumeric.h>
 #  include <QPrinter>
@@ -64,6 +76,8 @@ class QCPAxisRect;
 class QCPAxisPainterPrivate;
 class QCPAbstractPlottable;
 class QCPGraph;
+class QCPGraphPreparation;
+class QCPFrameRenderer;
 class QCPAbstractItem;
 class QCPItemPosition;
 class QCPLayer;
@@ -141,6 +155,11 @@ enum PlottingHint { phNone            = 0x000 ///< <tt>0x000</tt> No hints are s
                     ,phForceRepaint   = 0x002 ///< <tt>0x002</tt> causes an immediate repaint() instead of a soft update() when QCustomPlot::replot() is called with parameter \ref QCustomPlot::rpHint.
                                               ///<                This is set by default to prevent the plot from freezing on fast consecutive replots (e.g. user drags ranges with mouse).
                     ,phCacheLabels    = 0x004 ///< <tt>0x004</tt> axis (tick) labels will be cached as pixmaps, increasing replot performance.
+                    ,phParallelPreparation = 0x008 ///< <tt>0x008</tt> the pixel-space line data of all graphs that are about to be drawn is computed in parallel on the global QThreadPool,
+                                                   ///<                only the painting itself stays on the GUI thread. Helps with many overlaid graphs. Not set by default, because
+                                                   ///<                graph subclasses and custom axes must then be safe to read from several threads.
+                    ,phBackgroundRaster = 0x010 ///< <tt>0x010</tt> replots are recorded on the GUI thread and rasterized into a QImage on a worker thread, paint events only
+                                                ///<                show the newest finished frame. See \ref QCPFrameRenderer.
                   };
 Q_DECLARE_FLAGS(PlottingHints, PlottingHint)
 
@@ -320,6 +339,7 @@ public:
                      ,pmVectorized   = 0x01   ///< <tt>0x01</tt> Mode for vectorized painting (e.g. PDF export). For example, this prevents some antialiasing fixes.
                      ,pmNoCaching    = 0x02   ///< <tt>0x02</tt> Mode for all sorts of exports (e.g. PNG, PDF,...). For example, this prevents using cached pixmap labels
                      ,pmNonCosmetic  = 0x04   ///< <tt>0x04</tt> Turns pen widths 0 to 1, i.e. disables cosmetic pens. (A cosmetic pen is always drawn with width 1 pixel in the vector image/pdf viewer, independent of zoom.)
+                     ,pmNoPixmaps    = 0x08   ///< <tt>0x08</tt> Pixmaps and pixmap brushes are passed on as QImages, for recordings that are played back on another thread (see \ref QCP::phBackgroundRaster)
                    };
   Q_FLAGS(PainterMode PainterModes)
   Q_DECLARE_FLAGS(PainterModes, PainterMode)
@@ -344,6 +364,12 @@ public:
   void setPen(Qt::PenStyle penStyle);
   void drawLine(const QLineF &line);
   void drawLine(const QPointF &p1, const QPointF &p2) {drawLine(QLineF(p1, p2));}
+  void setBrush(const QBrush &brush);
+  void drawPixmap(const QRectF &target, const QPixmap &pixmap, const QRectF &source);
+  void drawPixmap(const QRectF &target, const QPixmap &pixmap);
+  void drawPixmap(const QPointF &point, const QPixmap &pixmap, const QRectF &source);
+  void drawPixmap(const QPointF &point, const QPixmap &pixmap);
+  void drawPixmap(int x, int y, const QPixmap &pixmap) {drawPixmap(QPointF(x, y), pixmap);}
   void save();
   void restore();
   
@@ -370,8 +396,18 @@ class QCP_LIB_DECL QCPLayer : public QObject
   Q_PROPERTY(int index READ index)
   Q_PROPERTY(QList<QCPLayerable*> children READ children)
   Q_PROPERTY(bool visible READ visible WRITE setVisible)
+  Q_PROPERTY(LayerMode mode READ mode WRITE setMode)
   /// \endcond
 public:
+  /*!
+    Defines how the layer's layerables get onto the plot during a replot.
+    \see setMode
+  */
+  enum LayerMode { lmLogical   ///< the layerables are drawn directly into the plot's paint buffer on every replot (default)
+                   ,lmBuffered ///< the layerables are drawn into a pixmap of the layer, which is only redrawn when the layer is replotted
+                 };
+  Q_ENUMS(LayerMode)
+  
   QCPLayer(QCustomPlot* parentPlot, const QString &layerName);
   ~QCPLayer();
   
@@ -381,9 +417,14 @@ public:
   int index() const { return mIndex; }
   QList<QCPLayerable*> children() const { return mChildren; }
   bool visible() const { return mVisible; }
+  LayerMode mode() const { return mMode; }
   
   // setters:
   void setVisible(bool visible);
+  void setMode(LayerMode mode);
+  
+  // non-property methods:
+  void replot();
   
 protected:
   // property members:
@@ -392,6 +433,11 @@ protected:
   int mIndex;
   QList<QCPLayerable*> mChildren;
   bool mVisible;
+  LayerMode mMode;
+  
+  // non-property members:
+  QPixmap mBuffer;
+  bool mBufferDirty;
   
   // non-virtual methods:
   void addChild(QCPLayerable *layerable, bool prepend);
@@ -1197,6 +1243,7 @@ public:
   void rescale(bool onlyVisiblePlottables=false);
   double pixelToCoord(double value) const;
   double coordToPixel(double value) const;
+  void coordsToPixels(const double *values, int valueStride, qreal *pixels, int pixelStride, int count) const;
   SelectablePart getPartAt(const QPointF &pos) const;
   QList<QCPAbstractPlottable*> plottables() const;
   QList<QCPGraph*> graphs() const;
@@ -1266,6 +1313,8 @@ protected:
   QVector<double> mSubTickVector;
   bool mCachedMarginValid;
   int mCachedMargin;
+  bool mCachedTicksValid;
+  QLocale mCachedTicksLocale;
   
   // introduced virtual methods:
   virtual void setupTickVectors();
@@ -1653,6 +1702,82 @@ private:
 };
 
 
+class QCP_LIB_DECL QCPReplotTimings
+{
+public:
+  QCPReplotTimings() : preparation(0), margins(0), layout(0), background(0), plotData(0), replot(0), paint(0) {}
+  
+  qint64 preparation, margins, layout; // the three layout update phases
+  qint64 background;
+  qint64 plotData; // graph data prepared ahead of the layers, see QCP::phParallelPreparation
+  QList<QPair<QString, qint64> > layers; // layer name and drawing time, bottom to top
+  qint64 replot; // the whole replot, without the widget repaint
+  qint64 paint; // drawing the paint buffer onto the widget in the last paintEvent
+};
+
+
+class QCP_LIB_DECL QCPGraphPreparation : public QRunnable
+{
+public:
+  QCPGraphPreparation(const QList<QCPGraph*> *graphs, QAtomicInt *nextIndex, QSemaphore *finished);
+  
+  virtual void run();
+  
+protected:
+  const QList<QCPGraph*> *mGraphs;
+  QAtomicInt *mNextIndex;
+  QSemaphore *mFinished;
+};
+
+
+class QCP_LIB_DECL QCPFrameRenderer : public QThread
+{
+  Q_OBJECT
+public:
+  explicit QCPFrameRenderer(QObject *parent=0);
+  virtual ~QCPFrameRenderer();
+  
+  // getters:
+  int droppedFrames() const;
+  
+  /*!
+    One step of a frame, see \ref submit.
+  */
+  struct Part
+  {
+    Part() : slot(-1), hasPicture(false) {}
+    int slot;        ///< the layer image this part uses, or -1 if \a picture is played into the frame directly
+    bool hasPicture; ///< whether \a picture is set. A part with a slot but no picture shows the image the slot already holds
+    QPicture picture;
+  };
+  
+  // non-property methods:
+  void submit(const QList<Part> &parts, const QSize &size, const QColor &fill);
+  bool takeFrame(QImage *frame);
+  void stop();
+  
+signals:
+  void frameReady();
+  
+protected:
+  // non-property members:
+  mutable QMutex mMutex;
+  QWaitCondition mWakeUp;
+  QList<Part> mPendingParts;
+  QSize mPendingSize;
+  QColor mPendingFill;
+  bool mHasPending;
+  bool mStopping;
+  QImage mFrame;
+  bool mHasFrame;
+  int mDroppedFrames;
+  QVector<QImage> mLayerImages; // only used by the renderer thread
+  
+  // reimplemented virtual methods:
+  virtual void run();
+};
+
+
 class QCP_LIB_DECL QCustomPlot : public QWidget
 {
   Q_OBJECT
@@ -1705,6 +1830,8 @@ public:
   bool noAntialiasingOnDrag() const { return mNoAntialiasingOnDrag; }
   QCP::PlottingHints plottingHints() const { return mPlottingHints; }
   Qt::KeyboardModifier multiSelectModifier() const { return mMultiSelectModifier; }
+  bool replotTimingEnabled() const { return mReplotTimingEnabled; }
+  QCPReplotTimings replotTimings() const { return mReplotTimings; }
 
   // setters:
   void setViewport(const QRect &rect);
@@ -1725,6 +1852,7 @@ public:
   void setPlottingHints(const QCP::PlottingHints &hints);
   void setPlottingHint(QCP::PlottingHint hint, bool enabled=true);
   void setMultiSelectModifier(Qt::KeyboardModifier modifier);
+  void setReplotTimingEnabled(bool enabled);
   
   // non-property methods:
   // plottable interface:
@@ -1791,6 +1919,7 @@ public:
   QPixmap toPixmap(int width=0, int height=0, double scale=1.0);
   void toPainter(QCPPainter *painter, int width=0, int height=0);
   Q_SLOT void replot(QCustomPlot::RefreshPriority refreshPriority=QCustomPlot::rpHint);
+  void invalidateLayout();
   
   QCPAxis *xAxis, *yAxis, *xAxis2, *yAxis2;
   QCPLegend *legend;
@@ -1838,12 +1967,20 @@ protected:
   QCPLayer *mCurrentLayer;
   QCP::PlottingHints mPlottingHints;
   Qt::KeyboardModifier mMultiSelectModifier;
+  bool mReplotTimingEnabled;
   
   // non-property members:
   QPixmap mPaintBuffer;
+  QCPReplotTimings mReplotTimings;
   QPoint mMousePressPos;
   QPointer<QCPLayoutElement> mMouseEventElement;
   bool mReplotting;
+  QCPFrameRenderer *mFrameRenderer;
+  QImage mRenderedFrame;
+  QSize mRasterSize;
+  QList<QCPLayer*> mRasterLayers;
+  bool mLayoutValid, mUpdatingLayout;
+  QVector<int> mLayoutAxisMargins;
   
   // reimplemented virtual methods:
   virtual QSize minimumSizeHint() const;
@@ -1865,6 +2002,15 @@ protected:
   void updateLayerIndices() const;
   QCPLayerable *layerableAt(const QPointF &pos, bool onlySelectable, QVariant *selectionDetails=0) const;
   void drawBackground(QCPPainter *painter);
+  void updatePlotLayout();
+  void drawLayers(QCPPainter *painter);
+  void drawLayer(QCPPainter *painter, QCPLayer *layer);
+  void prepareGraphs(const QList<QCPGraph*> &graphs);
+  void replotBufferedLayers();
+  void replotInBackground(bool withLayout);
+  Q_SLOT void frameRendered();
+  QVector<int> layoutAxisMargins();
+  static qint64 lapNsecs(QElapsedTimer &timer);
   
   friend class QCPLegend;
   friend class QCPAxis;
@@ -2463,6 +2609,103 @@ typedef QMapIterator<double, QCPData> QCPDataMapIterator;
 typedef QMutableMapIterator<double, QCPData> QCPDataMutableMapIterator;
 
 
+class QCP_LIB_DECL QCPDataVector
+{
+public:
+  class const_iterator
+  {
+  public:
+    const_iterator() : mVector(0), mIndex(0) {}
+    const_iterator(const QCPDataVector *vector, int index) : mVector(vector), mIndex(index) {}
+
+    double key() const { return mVector->key(mIndex); }
+    QCPData value() const { return mVector->at(mIndex); }
+    QCPData operator*() const { return mVector->at(mIndex); }
+    int index() const { return mIndex; }
+
+    const_iterator &operator++() { ++mIndex; return *this; }
+    const_iterator operator++(int) { const_iterator result(*this); ++mIndex; return result; }
+    const_iterator &operator--() { --mIndex; return *this; }
+    const_iterator operator--(int) { const_iterator result(*this); --mIndex; return result; }
+    const_iterator operator+(int j) const { return const_iterator(mVector, mIndex+j); }
+    const_iterator operator-(int j) const { return const_iterator(mVector, mIndex-j); }
+    int operator-(const const_iterator &other) const { return mIndex-other.mIndex; }
+    bool operator==(const const_iterator &other) const { return mIndex == other.mIndex; }
+    bool operator!=(const const_iterator &other) const { return mIndex != other.mIndex; }
+    bool operator<(const const_iterator &other) const { return mIndex < other.mIndex; }
+
+  private:
+    const QCPDataVector *mVector;
+    int mIndex;
+  };
+
+  QCPDataVector();
+
+  // getters:
+  int size() const { return mKeys.size()-mBegin; }
+  bool isEmpty() const { return size() == 0; }
+  bool hasErrors() const { return !mKeyErrorsMinus.isEmpty(); }
+  int capacity() const { return mCapacity; }
+  double key(int index) const { return mKeys.at(mBegin+index); }
+  double value(int index) const { return mValues.at(mBegin+index); }
+  QCPData at(int index) const;
+  const double *keyData() const { return mKeys.constData()+mBegin; }
+  const double *valueData() const { return mValues.constData()+mBegin; }
+  
+  // setters:
+  void setCapacity(int capacity);
+
+  // iterators and lookup:
+  const_iterator constBegin() const { return const_iterator(this, 0); }
+  const_iterator constEnd() const { return const_iterator(this, size()); }
+  const_iterator begin() const { return constBegin(); }
+  const_iterator end() const { return constEnd(); }
+  int lowerBoundIndex(double key) const;
+  int upperBoundIndex(double key) const;
+  const_iterator lowerBound(double key) const { return const_iterator(this, lowerBoundIndex(key)); }
+  const_iterator upperBound(double key) const { return const_iterator(this, upperBoundIndex(key)); }
+  void valueBounds(int from, int to, double &minValue, double &maxValue) const;
+
+  // non-property methods:
+  void clear();
+  void reserve(int size);
+  void set(const QVector<double> &keys, const QVector<double> &values);
+  void add(const QCPData &data);
+  void add(double key, double value);
+  void add(const QVector<double> &keys, const QVector<double> &values);
+  void add(const QCPDataMap &dataMap);
+  void appendSorted(const double *keys, const double *values, int count);
+  void appendSorted(const QVector<double> &keys, const QVector<double> &values);
+  void removeBefore(double key);
+  void removeAfter(double key);
+  void remove(double fromKey, double toKey);
+  void remove(double key);
+  QCPDataMap toMap() const;
+  void fromMap(const QCPDataMap &dataMap);
+
+protected:
+  // property members:
+  int mCapacity;
+  
+  // non-property members:
+  int mBegin; // index of the first present point in the arrays, the ones in front of it were removed
+  QVector<double> mKeys, mValues;
+  QVector<double> mKeyErrorsPlus, mKeyErrorsMinus, mValueErrorsPlus, mValueErrorsMinus; // empty until the first point with errors is added
+  mutable QVector<QVector<double> > mLodMin, mLodMax; // min/max pyramid over mValues, see valueBounds
+  mutable int mLodValidSize; // number of leading array entries the pyramid is up to date for
+
+  // non-virtual methods:
+  int insertIndex(double key) const;
+  void insert(int index, const QCPData &data);
+  void removeRange(int from, int to);
+  void evict();
+  void compact();
+  void allocateErrors();
+  void invalidateLod(int from) { if (from < mLodValidSize) mLodValidSize = from; }
+  void updateLod() const;
+};
+
+
 class QCP_LIB_DECL QCPGraph : public QCPAbstractPlottable
 {
   Q_OBJECT
@@ -2475,6 +2718,8 @@ class QCP_LIB_DECL QCPGraph : public QCPAbstractPlottable
   Q_PROPERTY(bool errorBarSkipSymbol READ errorBarSkipSymbol WRITE setErrorBarSkipSymbol)
   Q_PROPERTY(QCPGraph* channelFillGraph READ channelFillGraph WRITE setChannelFillGraph)
   Q_PROPERTY(bool adaptiveSampling READ adaptiveSampling WRITE setAdaptiveSampling)
+  Q_PROPERTY(DataStorage dataStorage READ dataStorage WRITE setDataStorage)
+  Q_PROPERTY(int dataCapacity READ dataCapacity WRITE setDataCapacity)
   /// \endcond
 public:
   /*!
@@ -2500,12 +2745,23 @@ public:
                    ,etBoth  ///< Error bars for both key and value dimensions of the data point are shown
                  };
   Q_ENUMS(ErrorType)
+  /*!
+    Defines which container holds the graph's data points.
+    \see setDataStorage
+  */
+  enum DataStorage { dsMap     ///< data is kept in the \ref QCPDataMap returned by \ref data (default)
+                     ,dsVector ///< data is kept in the contiguous, sorted \ref QCPDataVector returned by \ref vectorData
+                   };
+  Q_ENUMS(DataStorage)
   
   explicit QCPGraph(QCPAxis *keyAxis, QCPAxis *valueAxis);
   virtual ~QCPGraph();
   
   // getters:
   QCPDataMap *data() const { return mData; }
+  QCPDataVector *vectorData() const { return mDataVector; }
+  DataStorage dataStorage() const { return mDataStorage; }
+  int dataCapacity() const { return mDataVector->capacity(); }
   LineStyle lineStyle() const { return mLineStyle; }
   QCPScatterStyle scatterStyle() const { return mScatterStyle; }
   ErrorType errorType() const { return mErrorType; }
@@ -2532,16 +2788,21 @@ public:
   void setErrorBarSkipSymbol(bool enabled);
   void setChannelFillGraph(QCPGraph *targetGraph);
   void setAdaptiveSampling(bool enabled);
+  void setDataStorage(DataStorage storage);
+  void setDataCapacity(int capacity);
   
   // non-property methods:
   void addData(const QCPDataMap &dataMap);
   void addData(const QCPData &data);
   void addData(double key, double value);
   void addData(const QVector<double> &keys, const QVector<double> &values);
+  void appendData(const QVector<double> &keys, const QVector<double> &values);
+  void appendData(const double *keys, const double *values, int count);
   void removeDataBefore(double key);
   void removeDataAfter(double key);
   void removeData(double fromKey, double toKey);
   void removeData(double key);
+  void dataChanged();
   
   // reimplemented virtual methods:
   virtual void clearData();
@@ -2556,6 +2817,8 @@ public:
 protected:
   // property members:
   QCPDataMap *mData;
+  QCPDataVector *mDataVector;
+  DataStorage mDataStorage;
   QPen mErrorPen;
   LineStyle mLineStyle;
   QCPScatterStyle mScatterStyle;
@@ -2565,6 +2828,24 @@ protected:
   QPointer<QCPGraph> mChannelFillGraph;
   bool mAdaptiveSampling;
   
+  // non-property members:
+  QVector<QPointF> mPreparedLineData;
+  QVector<QCPData> mPreparedScatterData;
+  bool mHasPreparedData;
+  struct CachedRange
+  {
+    CachedRange() : valid(false), found(false) {}
+    bool valid, found;
+    QCPRange range;
+  };
+  mutable CachedRange mCachedRanges[2][3][2]; // [key, value][SignDomain][without, with errors], see getKeyRange
+  mutable QVector<QPointF> mHitPoints; // pixel points of the line (or scatters) last drawn or hit tested, see pointDistance
+  mutable QVector<double> mHitSignature; // axis and style state mHitPoints belong to, empty if they are outdated
+  mutable QVector<int> mHitColumnStart, mHitColumnSegments; // segments of mHitPoints by pixel column along the key axis
+  mutable int mHitColumnOrigin;
+  mutable int mSignatureCount; // data signature the cached ranges belong to, see checkDataSignature
+  mutable double mSignatureFirstKey, mSignatureLastKey;
+  
   // reimplemented virtual methods:
   virtual void draw(QCPPainter *painter);
   virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const;
@@ -2582,6 +2863,7 @@ protected:
   // non-virtual methods:
   void getPreparedData(QVector<QCPData> *lineData, QVector<QCPData> *scatterData) const;
   void getPlotData(QVector<QPointF> *lineData, QVector<QCPData> *scatterData) const;
+  void preparePlotData();
   void getScatterPlotData(QVector<QCPData> *scatterData) const;
   void getLinePlotData(QVector<QPointF> *linePixelData, QVector<QCPData> *scatterData) const;
   void getStepLeftPlotData(QVector<QPointF> *linePixelData, QVector<QCPData> *scatterData) const;
@@ -2589,8 +2871,21 @@ protected:
   void getStepCenterPlotData(QVector<QPointF> *linePixelData, QVector<QCPData> *scatterData) const;
   void getImpulsePlotData(QVector<QPointF> *linePixelData, QVector<QCPData> *scatterData) const;
   void drawError(QCPPainter *painter, double x, double y, const QCPData &data) const;
+  void drawClippedPolyline(QCPPainter *painter, const QVector<QPointF> *lineData, const QRectF &clip, bool separateLines) const;
+  static bool clipSegment(QPointF *start, QPointF *end, const QRectF &clip);
   void getVisibleDataBounds(QCPDataMap::const_iterator &lower, QCPDataMap::const_iterator &upper) const;
   int countDataInBounds(const QCPDataMap::const_iterator &lower, const QCPDataMap::const_iterator &upper, int maxCount) const;
+  int countDataInBounds(const QCPDataVector::const_iterator &lower, const QCPDataVector::const_iterator &upper, int maxCount) const;
+  bool hasData() const;
+  int dataCount() const;
+  void addMapData(const QCPData &data);
+  void invalidateCachedRanges() const;
+  void dataSignature(int &count, double &firstKey, double &lastKey) const;
+  void checkDataSignature() const;
+  void storeDataSignature() const;
+  void addToCachedRanges(const QCPData &data);
+  void removeFromCachedRanges(const QCPData &data);
+  static void extendRange(QCPRange &range, bool &haveLower, bool &haveUpper, double current, double errorMinus, double errorPlus, SignDomain inSignDomain);
   void addFillBasePoints(QVector<QPointF> *lineData) const;
   void removeFillBasePoints(QVector<QPointF> *lineData) const;
   QPointF lowerFillBasePoint(double lowerKey) const;
@@ -2601,9 +2896,22 @@ protected:
   int findIndexBelowY(const QVector<QPointF> *data, double y) const;
   int findIndexAboveY(const QVector<QPointF> *data, double y) const;
   double pointDistance(const QPointF &pixelPoint) const;
+  void dataToPixels(const QVector<QCPData> &data, QVector<qreal> *keyPixels, QVector<qreal> *valuePixels) const;
+  QVector<double> hitTestSignature() const;
+  void updateHitTestGrid() const;
+  
+  // templates shared by both storage modes (see \ref DataStorage), instantiated in the implementation only:
+  template <class DataContainer> void getPreparedData(const DataContainer *data, QVector<QCPData> *lineData, QVector<QCPData> *scatterData) const;
+  template <class DataContainer> void getAdaptiveLineData(const DataContainer *data, const typename DataContainer::const_iterator &lower, const typename DataContainer::const_iterator &upper, QVector<QCPData> *lineData) const;
+  void getAdaptiveLineData(const QCPDataVector *data, const QCPDataVector::const_iterator &lower, const QCPDataVector::const_iterator &upper, QVector<QCPData> *lineData) const;
+  template <class DataContainer> void getVisibleDataBounds(const DataContainer *data, typename DataContainer::const_iterator &lower, typename DataContainer::const_iterator &upper) const;
+  template <class DataContainer> QCPRange getKeyRange(const DataContainer *data, bool &foundRange, SignDomain inSignDomain, bool includeErrors) const;
+  template <class DataContainer> QCPRange getValueRange(const DataContainer *data, bool &foundRange, SignDomain inSignDomain, bool includeErrors) const;
   
   friend class QCustomPlot;
   friend class QCPLegend;
+  friend class QCPGraphPreparation;
+  friend class QCPItemTracer;
 };
 
 
@@ -2697,7 +3005,7 @@ protected:
   // non-virtual methods:
   void getCurveData(QVector<QPointF> *lineData) const;
   double pointDistance(const QPointF &pixelPoint) const;
-  QPointF outsideCoordsToPixels(double key, double value, int region, QRect axisRect) const;
+  void moveOutsideAxisRect(QPointF *pixelPoint, int region, QRect axisRect) const;
   
   friend class QCustomPlot;
   friend class QCPLegend;
@@ -2904,6 +3212,7 @@ public:
   void setCell(int keyIndex, int valueIndex, double z);
   
   // non-property methods:
+  void appendRow(const QVector<double> &row);
   void recalculateDataBounds();
   void clear();
   void fill(double z);
@@ -2920,6 +3229,11 @@ protected:
   double *mData;
   QCPRange mDataBounds;
   bool mDataModified;
+  int mFirstRow; // row of mData that holds value index 0, rows after it wrap around (see appendRow)
+  int mAppendedRows; // rows added by appendRow since the map image was last updated
+  
+  // non-virtual methods:
+  int cellIndex(int keyIndex, int valueIndex) const;
   
   friend class QCPColorMap;
 };
@@ -2987,6 +3301,7 @@ protected:
   
   // introduced virtual methods:
   virtual void updateMapImage();
+  virtual void updateAppendedRows();
   
   // reimplemented virtual methods:
   virtual void draw(QCPPainter *painter);
@@ -2994,6 +3309,9 @@ protected:
   virtual QCPRange getKeyRange(bool &foundRange, SignDomain inSignDomain=sdBoth) const;
   virtual QCPRange getValueRange(bool &foundRange, SignDomain inSignDomain=sdBoth) const;
   
+  // non-virtual methods:
+  void drawMapImage(QPainter *painter, const QRectF &targetRect, bool mirrorX, bool mirrorY) const;
+  
   friend class QCustomPlot;
   friend class QCPLegend;
 };
@@ -3469,6 +3787,7 @@ protected:
   // non-virtual methods:
   QPen mainPen() const;
   QBrush mainBrush() const;
+  template <class DataContainer> void updateGraphPosition(const DataContainer *data);
 };
 
 
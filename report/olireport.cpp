@@ -0,0 +1,416 @@
+/************************************************************************************************************
+**                                                                                                         **
+**  Headless batch export of recorded runs for OliView.                                                    **
+**  UC Davis iGEM 2014                                                                                     **
+**                                                                                                         **
+**                                                                                                         **
+*************************************************************************************************************/
+
+
+#include <QApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QImage>
+#include <QImageWriter>
+#include <QProcess>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+#include "qcustomplot.h"
+#include "sampleprotocol.h"
+
+/*
+    Renders recorded runs to PNG or PDF without a window. A run file is the byte stream the device
+    sent for one run, as captured from the serial port: files ending in .bin hold the binary frame
+    encoding, anything else the text encoding. Both are decoded with the same SampleFrameDecoder /
+    SampleLineParser OliView uses and checked against the run trailer the same way, so a capture that
+    OliView would reject (lost or corrupted samples, wrong count or checksum) is reported here too.
+
+    Every worker process sets up one plot like MainWindow::setupAldeSensGraph once and then only
+    swaps the graph data, the axis ranges and the plot title per run. PNGs are painted into a
+    single reused image and written with QImageWriter, PDFs go through QCustomPlot::savePdf.
+    The runs are spread over --jobs worker processes (QWidget painting is tied to the GUI thread,
+    so one process per core is how this scales), which get their file list on stdin. A figure is
+    named after its run file; inputs that would share a figure name are reported and skipped.
+
+    usage: OliReport [--out DIR] [--format png|pdf] [--size WxH] [--rate HZ] [--jobs N]
+                     [--compression 0-100] [--y-range LOW,HIGH] (FILE | DIRECTORY)...
+           default: current directory, png, 800x500, 2000 Hz, one job per core, y range fitted to each run
+*/
+
+namespace
+{
+struct Options
+{
+    QString outDir;
+    QString format;
+    int width;
+    int height;
+    double sampleRate;
+    int jobs;
+    int compression;        // QImageWriter quality, for PNG 0 is smallest and 100 fastest
+    bool fixedValueRange;
+    QCPRange valueRange;
+
+    Options() : outDir("."), format("png"), width(800), height(500), sampleRate(2000),
+        jobs(qMax(1, QThread::idealThreadCount())), compression(-1), fixedValueRange(false) {}
+};
+
+// file name of the figure for a run, without the extension of the output format
+QString figureName(const QString &runFile)
+{
+    return QFileInfo(runFile).completeBaseName();
+}
+
+// Keeps a run and checks it the way AcquisitionEngine does, including the trailer checksum.
+class CollectSink : public SampleSink
+{
+public:
+    QVector<double> values;
+    int expected;           // -1 until the run was announced
+    quint32 checksum;
+    bool finished;
+    int sentSamples;
+    quint32 sentChecksum;
+
+    CollectSink() : expected(-1), checksum(0), finished(false), sentSamples(0), sentChecksum(0) {}
+    void announced(int samples)
+    {
+        if (expected >= 0)
+            return;
+        expected = samples;
+        values.reserve(samples);
+    }
+    void decoded(const double *data, int count)
+    {
+        if (expected < 0 || finished)
+            return;
+        for (int i = 0; i < count; i++) {
+            checksum = SampleProtocol::runChecksum(checksum, SampleProtocol::voltsToCode(data[i]));
+            values.append(data[i]);
+        }
+    }
+    void ended(int samples, quint32 sent)
+    {
+        if (expected < 0 || finished)
+            return;
+        finished = true;
+        sentSamples = samples;
+        sentChecksum = sent;
+    }
+
+    // same order of checks as AcquisitionEngine::ended, empty if the run is fine
+    QString problem() const
+    {
+        if (expected < 0)
+            return "no run start";
+        if (!finished)
+            return QString("no end of run, %1 of %2 samples decoded").arg(values.size()).arg(expected);
+        if (values.size() > expected || sentSamples > expected)
+            return QString("more samples than the announced %1").arg(expected);
+        if (values.size() < expected || sentSamples < expected)
+            return QString("incomplete run, %1 of %2 samples decoded").arg(values.size()).arg(expected);
+        if (sentChecksum != checksum)
+            return QString("checksum mismatch, samples are corrupted");
+        return QString();
+    }
+};
+
+//---------------------------------------------------------------------------------------------Plot Template
+// The visual part of MainWindow::setupAldeSensGraph; the interaction slots have no use here.
+
+void setupTemplate(QCustomPlot *plot, const Options &options)
+{
+    plot->resize(options.width, options.height);
+
+    QCPGraph *graph = plot->addGraph();
+    graph->setDataStorage(QCPGraph::dsVector);   // a run is set at once and in time order
+    graph->setAntialiasedFill(false);
+    graph->setPen(QPen(Qt::blue));
+
+    plot->xAxis->setTickStep(2);
+    plot->axisRect()->setupFullAxesBox();
+    QObject::connect(plot->xAxis, SIGNAL(rangeChanged(QCPRange)), plot->xAxis2, SLOT(setRange(QCPRange)));
+    QObject::connect(plot->yAxis, SIGNAL(rangeChanged(QCPRange)), plot->yAxis2, SLOT(setRange(QCPRange)));
+
+    plot->yAxis->setRange(0, 3.3);
+    plot->xAxis->setLabel("Milliseconds (ms)");
+    plot->yAxis->setLabel("Volts (V)");
+
+    plot->plotLayout()->insertRow(0);
+    plot->plotLayout()->addElement(0, 0, new QCPPlotTitle(plot));
+}
+
+//------------------------------------------------------------------------------------------------Decode A Run
+
+bool loadRun(const QString &fileName, QVector<double> *values, QString *error)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+    QByteArray stream = file.readAll();
+
+    CollectSink sink;
+    if (fileName.endsWith(".bin", Qt::CaseInsensitive)) {
+        SampleFrameDecoder decoder;
+        decoder.feed(stream.constData(), stream.size(), &sink);
+        if (decoder.checksumErrors() > 0 || decoder.sequenceGaps() > 0) {
+            *error = QString("%1 frames with a bad checksum, %2 frames lost")
+                     .arg(decoder.checksumErrors()).arg(decoder.sequenceGaps());
+            return false;
+        }
+    } else {
+        SampleLineParser parser;
+        parser.feed(stream.constData(), stream.size(), &sink);
+    }
+    *error = sink.problem();
+    if (!error->isEmpty())
+        return false;
+    *values = sink.values;
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------Worker
+
+int runWorker(const Options &options)
+{
+    QCustomPlot plot;
+    setupTemplate(&plot, options);
+    QCPGraph *graph = plot.graph(0);
+    QCPPlotTitle *title = static_cast<QCPPlotTitle *>(plot.plotLayout()->element(0, 0));
+
+    bool pdf = options.format == "pdf";
+    QImage image(options.width, options.height, QImage::Format_RGB32);
+    QImageWriter writer;
+    writer.setFormat(options.format.toLatin1());
+    writer.setQuality(options.compression);
+
+    QVector<double> keys;
+    QVector<double> values;
+    QTextStream in(stdin);
+    QTextStream err(stderr);
+    int written = 0;
+    int failed = 0;
+    while (!in.atEnd()) {
+        QString fileName = in.readLine();
+        if (fileName.isEmpty())
+            continue;
+
+        QString error;
+        if (!loadRun(fileName, &values, &error)) {
+            err << fileName << ": " << error << "\n";
+            failed++;
+            continue;
+        }
+
+        // keys only need to grow, every run starts at 0 ms with the same step; setData uses as many as there are values
+        double xStep = 1000 / options.sampleRate;
+        for (int i = keys.size(); i < values.size(); i++)
+            keys.append(i * xStep);
+        graph->setData(keys, values);
+
+        plot.xAxis->setRange(0, values.isEmpty() ? 1000 : values.size() * xStep);
+        if (options.fixedValueRange)
+            plot.yAxis->setRange(options.valueRange);
+        else
+            graph->rescaleValueAxis();
+        QFileInfo info(fileName);
+        title->setText(info.fileName());
+
+        QString outName = QDir(options.outDir).filePath(figureName(fileName) + "." + options.format);
+        bool ok;
+        if (pdf) {
+            ok = plot.savePdf(outName, false, options.width, options.height, "OliView", info.fileName());
+        } else {
+            QCPPainter painter(&image);
+            plot.toPainter(&painter, options.width, options.height);
+            painter.end();
+            writer.setFileName(outName);
+            ok = writer.write(image);
+        }
+        if (ok) {
+            written++;
+        } else {
+            err << outName << ": could not be written\n";
+            failed++;
+        }
+    }
+
+    QTextStream(stdout) << written << " " << failed << "\n";
+    return 0;
+}
+
+//------------------------------------------------------------------------------------------------------Inputs
+
+// Runs whose figures would get the same file name (run.bin next to run.txt, or equal names in
+// different directories) would overwrite each other, so only the first one is kept and the others
+// are reported and counted in *skipped. Names are compared case-insensitively for the file systems
+// that do so.
+QStringList collectRuns(const QStringList &paths, int *skipped)
+{
+    QStringList candidates;
+    foreach (const QString &path, paths) {
+        QFileInfo info(path);
+        if (info.isDir()) {
+            QDir dir(path);
+            foreach (const QString &name, dir.entryList(QDir::Files, QDir::Name))
+                candidates << dir.filePath(name);
+        } else {
+            candidates << path;
+        }
+    }
+
+    QStringList runs;
+    QHash<QString, QString> figureOwners;
+    *skipped = 0;
+    foreach (const QString &run, candidates) {
+        QString figure = figureName(run).toLower();
+        if (figureOwners.contains(figure)) {
+            QTextStream(stderr) << run << ": same figure name as " << figureOwners.value(figure) << ", skipped\n";
+            (*skipped)++;
+            continue;
+        }
+        figureOwners.insert(figure, run);
+        runs << run;
+    }
+    return runs;
+}
+
+bool parseSize(const QString &text, int *width, int *height)
+{
+    QStringList parts = text.split('x');
+    if (parts.size() != 2)
+        return false;
+    bool okWidth, okHeight;
+    *width = parts.at(0).toInt(&okWidth);
+    *height = parts.at(1).toInt(&okHeight);
+    return okWidth && okHeight && *width > 0 && *height > 0;
+}
+
+bool parseRange(const QString &text, QCPRange *range)
+{
+    QStringList parts = text.split(',');
+    if (parts.size() != 2)
+        return false;
+    bool okLower, okUpper;
+    *range = QCPRange(parts.at(0).toDouble(&okLower), parts.at(1).toDouble(&okUpper));
+    return okLower && okUpper && range->lower < range->upper;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QStringList args;
+    for (int i = 1; i < argc; i++)
+        args << QString::fromLocal8Bit(argv[i]);
+
+    Options options;
+    QStringList paths;
+    bool worker = false;
+    bool valid = true;
+    for (int i = 0; i < args.size() && valid; i++) {
+        bool hasValue = i + 1 < args.size();
+        if (args.at(i) == "--out" && hasValue)
+            options.outDir = args.at(++i);
+        else if (args.at(i) == "--format" && hasValue)
+            options.format = args.at(++i).toLower();
+        else if (args.at(i) == "--size" && hasValue)
+            valid = parseSize(args.at(++i), &options.width, &options.height);
+        else if (args.at(i) == "--rate" && hasValue)
+            valid = (options.sampleRate = args.at(++i).toDouble()) > 0;
+        else if (args.at(i) == "--jobs" && hasValue)
+            valid = (options.jobs = args.at(++i).toInt()) > 0;
+        else if (args.at(i) == "--compression" && hasValue)
+            options.compression = qBound(-1, args.at(++i).toInt(), 100);
+        else if (args.at(i) == "--y-range" && hasValue)
+            valid = options.fixedValueRange = parseRange(args.at(++i), &options.valueRange);
+        else if (args.at(i) == "--worker")
+            worker = true;
+        else if (!args.at(i).startsWith("--"))
+            paths << args.at(i);
+        else
+            valid = false;
+    }
+    if (!valid || (options.format != "png" && options.format != "pdf") || (paths.isEmpty() && !worker)) {
+        QTextStream(stderr) << "usage: OliReport [--out DIR] [--format png|pdf] [--size WxH] [--rate HZ] [--jobs N]\n"
+                               "                 [--compression 0-100] [--y-range LOW,HIGH] (FILE | DIRECTORY)...\n";
+        return 2;
+    }
+
+    if (worker) {
+        if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        QApplication app(argc, argv);
+        return runWorker(options);
+    }
+
+    QCoreApplication app(argc, argv);
+    int skipped;
+    QStringList runs = collectRuns(paths, &skipped);
+    if (!QDir().mkpath(options.outDir)) {
+        QTextStream(stderr) << options.outDir << ": cannot create output directory\n";
+        return 1;
+    }
+
+    // the workers get every option except the inputs, which they read from stdin
+    QStringList workerArgs;
+    workerArgs << "--worker" << "--out" << options.outDir << "--format" << options.format
+               << "--size" << QString("%1x%2").arg(options.width).arg(options.height)
+               << "--rate" << QString::number(options.sampleRate, 'g', 17)
+               << "--compression" << QString::number(options.compression);
+    if (options.fixedValueRange)
+        workerArgs << "--y-range" << QString("%1,%2").arg(options.valueRange.lower, 0, 'g', 17).arg(options.valueRange.upper, 0, 'g', 17);
+
+    QElapsedTimer timer;
+    timer.start();
+    int jobs = qMax(1, qMin(options.jobs, runs.size()));
+    QList<QProcess *> workers;
+    for (int j = 0; j < jobs; j++) {
+        QProcess *process = new QProcess(&app);
+        process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        process->start(app.applicationFilePath(), workerArgs);
+        // round robin keeps the workers' shares even when the directory is sorted by run size
+        QByteArray list;
+        for (int i = j; i < runs.size(); i += jobs)
+            list += QFile::encodeName(runs.at(i)) + "\n";
+        process->write(list);
+        process->closeWriteChannel();   // takes effect once the list is written
+        workers << process;
+    }
+
+    // QProcess only writes the lists out of its buffers from the event loop, so keep it turning until
+    // every worker is done; waiting on one worker at a time would leave the others without input
+    forever {
+        bool running = false;
+        foreach (QProcess *process, workers)
+            running = running || process->state() != QProcess::NotRunning;
+        if (!running)
+            break;
+        app.processEvents(QEventLoop::WaitForMoreEvents);
+    }
+
+    int written = 0;
+    int failed = skipped;
+    foreach (QProcess *process, workers) {
+        if (process->error() == QProcess::FailedToStart || process->exitStatus() != QProcess::NormalExit || process->exitCode() != 0) {
+            QTextStream(stderr) << "worker failed: " << process->errorString() << "\n";
+            return 1;
+        }
+        QStringList counts = QString::fromLatin1(process->readAllStandardOutput()).split(' ');
+        written += counts.value(0).toInt();
+        failed += counts.value(1).toInt();
+    }
+
+    double seconds = timer.nsecsElapsed() / 1e9;
+    QTextStream(stdout) << written << " figures written, " << failed << " failed, in "
+                        << QString::number(seconds, 'f', 2) << " s ("
+                        << QString::number(written / qMax(seconds, 1e-9), 'f', 1) << " figures/s, "
+                        << jobs << " jobs)\n";
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,342 @@
+/************************************************************************************************************
+**                                                                                                         **
+**  Wire format shared by SoftKeyboardInterface.ino and OliView.                                           **
+**  UC Davis iGEM 2014                                                                                     **
+**                                                                                                         **
+**                                                                                                         **
+*************************************************************************************************************/
+
+
+#include "sampleprotocol.h"
+#include <QByteArray>
+#include <string.h>
+
+using namespace SampleProtocol;
+
+/*************************************************************************************************************/
+/************************************************* CHECKSUM **************************************************/
+/*************************************************************************************************************/
+
+// Frames are at most 262 bytes, so the running sums fit in 32 bits and the modulo can wait until the end.
+// The firmware computes the same thing in sendFrame().
+
+quint16 SampleProtocol::fletcher16(const quint8 *data, int size)
+{
+    quint32 sum1 = 0;
+    quint32 sum2 = 0;
+
+    for (int i = 0; i < size; i++) {
+        sum1 += data[i];
+        sum2 += sum1;
+    }
+    return quint16(((sum2 % 255) << 8) | (sum1 % 255));
+}
+
+/*************************************************************************************************************/
+/*********************************************** FRAME DECODER ***********************************************/
+/*************************************************************************************************************/
+
+SampleFrameDecoder::SampleFrameDecoder()
+{
+    reset();
+}
+
+void SampleFrameDecoder::reset()
+{
+    pendingSize = 0;
+    nextSequence = -1;
+    badFrames = 0;
+    lostFrames = 0;
+}
+
+//----------------------------------------------------------------------------------------------------Feed Raw Bytes
+
+void SampleFrameDecoder::feed(const char *data, int size, SampleSink *sink)
+{
+    const quint8 *in = reinterpret_cast<const quint8 *>(data);
+    int pos = 0;
+
+    while (pos < size) {
+
+        if (pendingSize > 0) {
+            // complete the frame left over from the previous read
+            int wanted = (pendingSize < HeaderSize) ? HeaderSize : HeaderSize + pending[4] + ChecksumSize;
+            int take = qMin(wanted - pendingSize, size - pos);
+            memcpy(pending + pendingSize, in + pos, take);
+            pendingSize += take;
+            pos += take;
+
+            bool broken = (pendingSize >= 2 && pending[1] != SyncByte2);
+            if (!broken && pendingSize >= HeaderSize) {
+                int frameSize = HeaderSize + pending[4] + ChecksumSize;
+                if (pendingSize < frameSize)
+                    continue;
+                quint16 checksum = pending[frameSize-2] | (pending[frameSize-1] << 8);
+                if (fletcher16(pending + 2, frameSize - 4) == checksum) {
+                    decodeFrame(pending, sink);
+                    pendingSize = 0;
+                    continue;
+                }
+                badFrames++;
+                broken = true;
+            }
+            if (broken) {
+                // not a frame after all, rescan everything after the false sync byte
+                quint8 rest[sizeof(pending)];
+                int restSize = pendingSize - 1;
+                memcpy(rest, pending + 1, restSize);
+                pendingSize = 0;
+                feed(reinterpret_cast<const char *>(rest), restSize, sink);
+            }
+            continue;
+        }
+
+        if (in[pos] != SyncByte1) {
+            pos++;
+            continue;
+        }
+
+        int available = size - pos;
+        if (available >= 2 && in[pos+1] != SyncByte2) {
+            pos++;
+            continue;
+        }
+
+        if (available >= HeaderSize) {
+            int frameSize = HeaderSize + in[pos+4] + ChecksumSize;
+            if (available >= frameSize) {
+                quint16 checksum = in[pos+frameSize-2] | (in[pos+frameSize-1] << 8);
+                if (fletcher16(in + pos + 2, frameSize - 4) == checksum) {
+                    decodeFrame(in + pos, sink);
+                    pos += frameSize;
+                } else {
+                    badFrames++;
+                    pos++;
+                }
+                continue;
+            }
+        }
+
+        // frame continues in the next read
+        memcpy(pending, in + pos, available);
+        pendingSize = available;
+        pos = size;
+    }
+}
+
+//-----------------------------------------------------------------------------------------------Decode Valid Frame
+
+void SampleFrameDecoder::decodeFrame(const quint8 *frame, SampleSink *sink)
+{
+    quint8 type = frame[2];
+    int sequence = frame[3];
+    int length = frame[4];
+    const quint8 *payload = frame + HeaderSize;
+
+    if (type == FrameRunStart && length >= 4) {
+        quint32 count = payload[0] | (payload[1] << 8) | (payload[2] << 16) | (quint32(payload[3]) << 24);
+        nextSequence = (sequence + 1) & 0xFF;
+        sink->announced(int(count));
+        return;
+    }
+
+    if (type == FrameRunEnd && length >= 8) {
+        quint32 count = payload[0] | (payload[1] << 8) | (payload[2] << 16) | (quint32(payload[3]) << 24);
+        quint32 checksum = payload[4] | (payload[5] << 8) | (payload[6] << 16) | (quint32(payload[7]) << 24);
+        sink->ended(int(count), checksum);
+        return;
+    }
+
+    if (type == FrameSamples) {
+        if (nextSequence >= 0 && sequence != nextSequence)
+            lostFrames += (sequence - nextSequence) & 0xFF;
+        nextSequence = (sequence + 1) & 0xFF;
+
+        int count = length / 2;
+        for (int i = 0; i < count; i++)
+            values[i] = codeToVolts(quint16(payload[2*i] | (payload[2*i+1] << 8)));
+        sink->decoded(values, count);
+    }
+}
+
+/*************************************************************************************************************/
+/************************************************ LINE PARSER ************************************************/
+/*************************************************************************************************************/
+
+SampleLineParser::SampleLineParser()
+{
+    reset();
+}
+
+void SampleLineParser::reset()
+{
+    pendingSize = 0;
+    pendingOverflow = false;
+    awaitingHeader = true;
+    badLines = 0;
+    batchSize = 0;
+}
+
+//----------------------------------------------------------------------------------------------------Feed Raw Bytes
+
+void SampleLineParser::feed(const char *data, int size, SampleSink *sink)
+{
+    const char *p = data;
+    const char *end = data + size;
+
+    while (p < end) {
+        const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+        const char *lineEnd = newline ? newline : end;
+
+        if (newline && pendingSize == 0 && !pendingOverflow) {
+            parseLine(p, lineEnd, sink);    // common case: the whole line is in this read
+        } else {
+            // keep the start of a split line until its end arrives
+            int n = int(lineEnd - p);
+            int room = MaxLineLength - pendingSize;
+            if (n > room) {
+                n = room;
+                pendingOverflow = true;
+            }
+            memcpy(pending + pendingSize, p, n);
+            pendingSize += n;
+
+            if (newline) {
+                if (pendingOverflow)
+                    badLines++;
+                else
+                    parseLine(pending, pending + pendingSize, sink);
+                pendingSize = 0;
+                pendingOverflow = false;
+            }
+        }
+
+        if (!newline)
+            break;
+        p = newline + 1;
+    }
+
+    flush(sink);
+}
+
+//--------------------------------------------------------------------------------------------------One Full Line
+
+void SampleLineParser::parseLine(const char *begin, const char *end, SampleSink *sink)
+{
+    while (begin < end && (*begin == ' ' || *begin == '\t'))
+        begin++;
+    while (end > begin && (end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t'))
+        end--;
+    if (begin == end)
+        return;
+
+    if (*begin == '#') {
+        if (!parseTrailer(begin, end, sink))
+            badLines++;
+        return;
+    }
+
+    if (awaitingHeader) {
+        int count = 0;
+        const char *p = begin;
+        while (p < end && *p >= '0' && *p <= '9' && count < 100000000)
+            count = count*10 + (*p++ - '0');
+        if (p != end) {
+            badLines++;
+            return;
+        }
+        awaitingHeader = false;
+        sink->announced(count);
+        return;
+    }
+
+    double value;
+    if (!parseDecimal(begin, end, &value)) {
+        badLines++;
+        return;
+    }
+    batch[batchSize++] = value;
+    if (batchSize == BatchSize)
+        flush(sink);
+}
+
+//--------------------------------------------------------------------------------------------------End Of Run Line
+
+bool SampleLineParser::parseTrailer(const char *begin, const char *end, SampleSink *sink)
+{
+    static const char tag[] = "#end,";
+    const int tagSize = sizeof(tag) - 1;
+    if (end - begin < tagSize || memcmp(begin, tag, tagSize) != 0)
+        return false;
+
+    quint32 numbers[2] = { 0, 0 };
+    const char *p = begin + tagSize;
+    for (int i = 0; i < 2; i++) {
+        const char *digits = p;
+        while (p < end && *p >= '0' && *p <= '9')
+            numbers[i] = numbers[i]*10 + quint32(*p++ - '0');
+        if (p == digits || (i == 0 && (p == end || *p++ != ',')))
+            return false;
+    }
+    if (p != end)
+        return false;
+
+    flush(sink);    // every sample before the trailer first
+    awaitingHeader = true;
+    sink->ended(int(numbers[0]), numbers[1]);
+    return true;
+}
+
+void SampleLineParser::flush(SampleSink *sink)
+{
+    if (batchSize > 0) {
+        sink->decoded(batch, batchSize);
+        batchSize = 0;
+    }
+}
+
+//-------------------------------------------------------------------------------------------Fixed Format Decimal
+// Up to 15 significant digits the mantissa is exact in a double, so one correctly rounded division
+// gives the same result as a full strtod.
+
+bool SampleLineParser::parseDecimal(const char *begin, const char *end, double *value)
+{
+    static const double powersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+                                          1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+
+    const char *p = begin;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+
+    quint64 mantissa = 0;
+    int digits = 0;
+    int fraction = 0;
+    bool point = false;
+    for (; p < end; p++) {
+        unsigned int digit = (unsigned char)*p - '0';
+        if (digit < 10 && digits < 15) {
+            mantissa = mantissa*10 + digit;
+            digits++;
+            if (point)
+                fraction++;
+        } else if (*p == '.' && !point) {
+            point = true;
+        } else {
+            break;
+        }
+    }
+
+    if (p == end && digits > 0) {
+        double result = double(mantissa) / powersOfTen[fraction];
+        *value = negative ? -result : result;
+        return true;
+    }
+
+    // exponents, more than 15 digits, nan/inf: rare, let Qt do it (C locale, no copy of the line)
+    bool ok = false;
+    *value = QByteArray::fromRawData(begin, int(end - begin)).toDouble(&ok);
+    return ok;
+}
@@ -0,0 +1,169 @@
+/************************************************************************************************************
+**                                                                                                         **
+**  Wire format shared by SoftKeyboardInterface.ino and OliView.                                           **
+**  UC Davis iGEM 2014                                                                                     **
+**                                                                                                         **
+**                                                                                                         **
+*************************************************************************************************************/
+
+
+#ifndef SAMPLEPROTOCOL_H
+#define SAMPLEPROTOCOL_H
+
+#include <QtGlobal>
+
+/*
+    Binary streaming mode ("encoding!B@#$%"). Every frame looks like
+
+        offset  size  field
+        0       1     sync 0xA5
+        1       1     sync 0x5A
+        2       1     type ('S' run start, 'D' samples, 'E' run end)
+        3       1     sequence number, starts at 0 with the 'S' frame and wraps at 256
+        4       1     payload length in bytes
+        5       len   payload
+        5+len   2     Fletcher-16 over bytes 2 .. 4+len, little endian
+
+    'S' payload: uint32 LE sample count of the run
+    'D' payload: up to SamplesPerFrame raw 16 bit ADC codes, uint16 LE
+    'E' payload: uint32 LE number of samples sent, uint32 LE runChecksum() over their ADC codes
+
+    The text encoding ends a run with the same two numbers on a line of their own: "#end,<count>,<checksum>".
+
+    Compared to Serial.println(volts, 6) this is about 2.2 instead of ~10 bytes per sample.
+*/
+
+namespace SampleProtocol
+{
+const quint8 SyncByte1 = 0xA5;
+const quint8 SyncByte2 = 0x5A;
+
+const quint8 FrameRunStart = 'S';
+const quint8 FrameSamples  = 'D';
+const quint8 FrameRunEnd   = 'E';
+
+const int HeaderSize      = 5;
+const int ChecksumSize    = 2;
+const int SamplesPerFrame = 32;
+const int MaxPayload      = 255;
+
+// firmware conversion of an ADC code to volts: value * aRef / 65535.0 - aRef/2
+const double ADCReference = 2.048;
+
+inline double codeToVolts(quint16 code)
+{
+    return code * (ADCReference / 65535.0) - ADCReference / 2;
+}
+
+// inverse of codeToVolts; exact for the 6 decimals the text encoding prints (one code is ~31 uV)
+inline quint16 voltsToCode(double volts)
+{
+    return quint16(qBound(0, qRound((volts + ADCReference / 2) * (65535.0 / ADCReference)), 65535));
+}
+
+// end-of-run checksum, one step per sample in the order sent; starts at 0
+inline quint32 runChecksum(quint32 checksum, quint16 code)
+{
+    return checksum * 31 + code;
+}
+
+quint16 fletcher16(const quint8 *data, int size);
+
+// USB identity of the Teensy 3.1 running SoftKeyboardInterface.ino (PJRC serial device)
+const quint16 DeviceVendorId  = 0x16C0;
+const quint16 DeviceProductId = 0x0483;
+
+// average bytes on the wire per sample, used to tell whether a link can keep up with a sampling rate
+const double TextLineSize = 11;     // "-1.023969\r\n"
+
+inline double bytesPerSample(bool binary)
+{
+    return binary ? double(HeaderSize + 2*SamplesPerFrame + ChecksumSize) / SamplesPerFrame : TextLineSize;
+}
+}
+
+/*
+    Receives the decoded stream. Implemented by the acquisition engine, driven by the decoders.
+*/
+
+class SampleSink
+{
+public:
+    virtual ~SampleSink() {}
+
+    virtual void announced(int samples) = 0;
+    virtual void decoded(const double *values, int count) = 0;
+    virtual void ended(int samples, quint32 checksum) = 0;
+};
+
+/*
+    Decodes binary frames. Bytes may be fed in arbitrarily sized pieces; a frame split across
+    two reads is completed on the next feed(). Frames with a bad checksum are dropped and the
+    decoder resynchronises on the next sync pair.
+*/
+
+class SampleFrameDecoder
+{
+public:
+    SampleFrameDecoder();
+
+    void reset();
+    void feed(const char *data, int size, SampleSink *sink);
+
+    int checksumErrors() const { return badFrames; }
+    int sequenceGaps() const { return lostFrames; }
+
+private:
+    void decodeFrame(const quint8 *frame, SampleSink *sink);
+
+    quint8 pending[SampleProtocol::HeaderSize + SampleProtocol::MaxPayload + SampleProtocol::ChecksumSize];
+    int pendingSize;
+
+    int nextSequence;   // -1 until a run start frame was seen
+    int badFrames;
+    int lostFrames;
+
+    double values[SampleProtocol::MaxPayload / 2];
+};
+
+/*
+    Parses the text encoding ("encoding!A@#$%") straight from the raw read buffer: the first line
+    of a run is the sample count, every following line one reading printed with Serial.println(v, 6),
+    and the run ends with a "#end,<count>,<checksum>" trailer line.
+
+    No QString or QByteArray is created per line. A line split across two reads is kept in a small
+    fixed buffer until its end arrives, and fixed-format decimals ("-1.023969") are converted with
+    integer arithmetic; only unusual spellings (exponents, nan) fall back to a library conversion.
+*/
+
+class SampleLineParser
+{
+public:
+    SampleLineParser();
+
+    void reset();
+    void feed(const char *data, int size, SampleSink *sink);
+
+    int malformedLines() const { return badLines; }
+
+    static bool parseDecimal(const char *begin, const char *end, double *value);
+
+private:
+    void parseLine(const char *begin, const char *end, SampleSink *sink);
+    bool parseTrailer(const char *begin, const char *end, SampleSink *sink);
+    void flush(SampleSink *sink);
+
+    enum { MaxLineLength = 64, BatchSize = 256 };
+
+    char pending[MaxLineLength];
+    int pendingSize;
+    bool pendingOverflow;   // current line is longer than any valid line, drop it
+
+    bool awaitingHeader;
+    int badLines;
+
+    double batch[BatchSize];
+    int batchSize;
+};
+
+#endif // SAMPLEPROTOCOL_H
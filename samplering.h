@@ -0,0 +1,123 @@
+/************************************************************************************************************
+**                                                                                                         **
+**  Lock-free sample hand-off from the serial reader thread to the GUI.                                    **
+**  UC Davis iGEM 2014                                                                                     **
+**                                                                                                         **
+**                                                                                                         **
+*************************************************************************************************************/
+
+
+#ifndef SAMPLERING_H
+#define SAMPLERING_H
+
+#include <QAtomicInt>
+#include <QVector>
+
+/*
+    Fixed-capacity single-producer/single-consumer ring buffer. The reader thread is the only
+    caller of push(), the GUI thread the only caller of pop(); neither ever blocks or allocates.
+
+    When the GUI falls behind far enough for the ring to fill up, push() stores what fits and
+    counts the rest in overflowCount(). highWaterMark() is the largest fill level the producer
+    has ever seen, so a run can be proven lossless (overflowCount() == 0) together with how
+    much headroom was left.
+*/
+
+template <typename T>
+class SampleRing
+{
+public:
+    // capacity is rounded up to a power of two; one slot is kept free to tell full from empty
+    explicit SampleRing(int capacity)
+    {
+        int size = 2;
+        while (size < capacity + 1)
+            size *= 2;
+        buffer.resize(size);
+        cells = buffer.data();     // detach once here, both threads only use the raw pointer
+        mask = size - 1;
+    }
+
+    int capacity() const { return mask; }
+
+    // number of samples waiting; exact from either side, approximate from any other thread
+    int size() const
+    {
+        return (head.loadAcquire() - tail.loadAcquire()) & mask;
+    }
+
+    //-------------------------------------------------------------------------------------------Producer Side
+
+    int push(const T *values, int count)
+    {
+        int h = head.load();
+        int t = tail.loadAcquire();
+        int room = mask - ((h - t) & mask);
+        int n = qMin(count, room);
+
+        int first = qMin(n, mask + 1 - h);      // up to the end of the buffer
+        for (int i = 0; i < first; i++)
+            cells[h + i] = values[i];
+        for (int i = first; i < n; i++)         // wrapped part
+            cells[i - first] = values[i];
+
+        head.storeRelease((h + n) & mask);
+
+        int fill = mask - room + n;
+        if (fill > highWater.load())
+            highWater.store(fill);
+        if (n < count)
+            overflow.fetchAndAddRelaxed(count - n);
+        return n;
+    }
+
+    //-------------------------------------------------------------------------------------------Consumer Side
+
+    int pop(T *out, int maxCount)
+    {
+        int t = tail.load();
+        int h = head.loadAcquire();
+        int n = qMin(maxCount, (h - t) & mask);
+
+        int first = qMin(n, mask + 1 - t);
+        for (int i = 0; i < first; i++)
+            out[i] = cells[t + i];
+        for (int i = first; i < n; i++)
+            out[i] = cells[i - first];
+
+        tail.storeRelease((t + n) & mask);
+        return n;
+    }
+
+    // throws away everything currently waiting
+    void discard()
+    {
+        tail.storeRelease(head.loadAcquire());
+    }
+
+    //----------------------------------------------------------------------------------------------Statistics
+
+    int overflowCount() const { return overflow.load(); }
+    int highWaterMark() const { return highWater.load(); }
+
+    // call from the producer thread, or while the producer is known to be idle
+    void resetStatistics()
+    {
+        overflow.store(0);
+        highWater.store(0);
+    }
+
+private:
+    QVector<T> buffer;
+    T *cells;
+    int mask;
+
+    QAtomicInt head;        // next slot the producer writes
+    QAtomicInt tail;        // next slot the consumer reads
+    QAtomicInt overflow;    // samples rejected because the ring was full
+    QAtomicInt highWater;   // largest fill level seen by the producer
+
+    Q_DISABLE_COPY(SampleRing)
+};
+
+#endif // SAMPLERING_H